@@ -1,33 +1,91 @@
 #include "config.hpp"
+#include "journal.hpp"
+#include "library.hpp"
+#include <algorithm>
 #include <chrono>
 #include <fancy.hpp>
 #include <filesystem>
 #include <fstream>
 #include <helper/json/bindings.hpp>
+#include <helper/misc/misc.hpp>
+#include <helper/trace/trace.hpp>
 #include <string>
 
 namespace Soundux::Objects
 {
-    const std::string Config::path = []() -> std::string {
+    static std::string getDirectory()
+    {
 #if defined(__linux__)
         const auto *configPath = std::getenv("XDG_CONFIG_HOME"); // NOLINT
         if (configPath)
         {
-            return std::string(configPath) + "/Soundux/config.json";
+            return std::string(configPath) + "/Soundux/";
         }
-        return std::string(std::getenv("HOME")) + "/.config/Soundux/config.json"; // NOLINT
+        return std::string(std::getenv("HOME")) + "/.config/Soundux/"; // NOLINT
 #elif defined(_WIN32)
         char *buffer;
         std::size_t size;
         _dupenv_s(&buffer, &size, "APPDATA");
-        auto rtn = std::string(buffer) + "\\Soundux\\config.json";
+        auto rtn = std::string(buffer) + "\\Soundux\\";
         free(buffer);
 
         return rtn;
 #endif
-    }();
+    }
+
+    const std::string Config::path = getDirectory() + "config.json";
+    const std::string Config::settingsPath = getDirectory() + "settings.json";
+    const std::string Config::cachePath = getDirectory() + "cache.json";
+    const std::string Config::manifestPath = getDirectory() + "manifest.json";
 
-    void Config::save()
+    static std::optional<nlohmann::json> readJson(const std::string &path)
+    {
+        if (!std::filesystem::exists(path))
+        {
+            return std::nullopt;
+        }
+
+        std::ifstream stream(path);
+        std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        stream.close();
+
+        auto json = nlohmann::json::parse(content, nullptr, false);
+        if (json.is_discarded())
+        {
+            Fancy::fancy.logTime().failure() << path << " seems corrupted" << std::endl;
+            return std::nullopt;
+        }
+
+        return json;
+    }
+
+    //* Keeps a file we could not read around under a new name, so that it is not overwritten by the next save
+    static bool moveAside(const std::string &path)
+    {
+        std::filesystem::path file(path);
+
+        std::error_code ec;
+        if (!std::filesystem::exists(file, ec))
+        {
+            return true;
+        }
+
+        std::filesystem::rename(
+            file, file.parent_path() / (file.stem().u8string() + "_old_" +
+                                        std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) +
+                                        file.extension().u8string()),
+            ec);
+
+        if (ec)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to move " << path << ": " << ec.message() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Config::save()
     {
         try
         {
@@ -36,10 +94,23 @@ namespace Soundux::Objects
                 std::filesystem::path configFile(path);
                 std::filesystem::create_directories(configFile.parent_path());
             }
-            std::ofstream configFile(path);
-            configFile << nlohmann::json(*this).dump();
-            configFile.close();
-            Fancy::fancy.logTime().success() << "Config written" << std::endl;
+
+            auto success = saveSettings(settings);
+            success = saveCache(loudness) && success;
+            success = saveManifests(manifests) && success;
+
+            if (keepLibrary)
+            {
+                Fancy::fancy.logTime().warning() << "Not writing library, the stored one could not be read"
+                                                 << std::endl;
+                return false;
+            }
+
+            if (snapshot(data, settings.binaryLibrary, journalSequence).write() && success)
+            {
+                Fancy::fancy.logTime().success() << "Config written" << std::endl;
+                return true;
+            }
         }
         catch (const std::exception &e)
         {
@@ -49,47 +120,142 @@ namespace Soundux::Objects
         {
             Fancy::fancy.logTime().failure() << "Failed to write config" << std::endl;
         }
+
+        return false;
+    }
+    bool Config::saveSettings(const Settings &settings)
+    {
+        return Helpers::writeFile(settingsPath, nlohmann::json(settings).dump());
+    }
+    bool Config::saveCache(const std::map<std::string, LoudnessInfo> &loudness)
+    {
+        return Helpers::writeFile(cachePath, nlohmann::json(loudness).dump());
+    }
+    bool Config::saveManifests(const std::map<std::string, DirectoryManifest> &manifests)
+    {
+        return Helpers::writeFile(manifestPath, nlohmann::json(manifests).dump());
+    }
+    ConfigSnapshot Config::snapshot(const Data &data, bool binaryLibrary, std::uint64_t journalSequence)
+    {
+        ConfigSnapshot rtn;
+        //* The format is stored next to the data it describes, the settings are saved on their own and might disagree
+        nlohmann::json config = {{"journalSequence", journalSequence}, {"library", binaryLibrary ? "binary" : "json"}};
+
+        if (binaryLibrary)
+        {
+            //* The tabs live in the library snapshot, the config only keeps the rest of the data so it stays small
+            config["data"] = {{"height", data.height},
+                              {"width", data.width},
+                              {"tabs", nlohmann::json::array()},
+                              {"soundIdCounter", data.soundIdCounter}};
+            rtn.library = LibrarySnapshot::serialize(data, journalSequence);
+        }
+        else
+        {
+            config["data"] = data;
+        }
+
+        rtn.config = config.dump();
+        return rtn;
+    }
+    bool ConfigSnapshot::write() const
+    {
+        //* The config is written first. A library that ends up older than the config (because writing it failed) is
+        //* caught up by the journal, which is only cleared after both were written.
+        if (!Helpers::writeFile(Config::path, config))
+        {
+            return false;
+        }
+
+        if (library)
+        {
+            return Helpers::writeFile(LibrarySnapshot::getPath(), *library);
+        }
+
+        //* Only removed once a config that holds all tabs was written
+        LibrarySnapshot::remove();
+        return true;
     }
     void Config::load()
     {
+        TraceScope scope("Config::load");
+
         try
         {
-            if (!std::filesystem::exists(path))
+            auto json = readJson(path);
+
+            //* Settings and the cache used to be part of the config, which is used as fallback until they were saved
+            if (auto storedSettings = readJson(settingsPath); storedSettings)
             {
-                Fancy::fancy.logTime().warning() << "Config not found" << std::endl;
-                return;
+                storedSettings->get_to(settings);
+            }
+            else if (json && json->find("settings") != json->end())
+            {
+                json->at("settings").get_to(settings);
             }
 
-            std::ifstream configStream(path);
-            std::string content((std::istreambuf_iterator<char>(configStream)), std::istreambuf_iterator<char>());
-            configStream.close();
-
-            auto json = nlohmann::json::parse(content, nullptr, false);
-            if (json.is_discarded())
+            if (auto storedCache = readJson(cachePath); storedCache)
             {
-                Fancy::fancy.logTime().failure() << "Config seems corrupted" << std::endl;
+                storedCache->get_to(loudness);
             }
-            else
+            else if (json && json->find("loudness") != json->end())
+            {
+                json->at("loudness").get_to(loudness);
+            }
+
+            if (auto storedManifests = readJson(manifestPath); storedManifests)
             {
                 try
                 {
-                    auto conf = json.get<Config>();
-                    data.set(conf.data);
-                    settings = conf.settings;
-                    Fancy::fancy.logTime().success() << "Config read" << std::endl;
+                    storedManifests->get_to(manifests);
                 }
                 catch (...)
                 {
-                    Fancy::fancy.logTime().warning()
-                        << "Found possibly old config format, moving old config..." << std::endl;
-
-                    std::filesystem::path configFile(path);
-                    std::filesystem::rename(
-                        path,
-                        configFile.parent_path() /
-                            ("config_old_" +
-                             std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".json"));
+                    //* The manifests can always be rebuilt by scanning again
+                    manifests.clear();
+                }
+            }
+
+            if (!json)
+            {
+                Fancy::fancy.logTime().warning() << "Config not found" << std::endl;
+                return;
+            }
+
+            try
+            {
+                auto conf = json->get<Config>();
+                if (json->value("library", "json") == "binary")
+                {
+                    if (auto librarySequence = LibrarySnapshot::load(conf.data); librarySequence)
+                    {
+                        //* Replay the journal from whichever of both is older
+                        conf.journalSequence = std::min(conf.journalSequence, *librarySequence);
+                    }
+                    else
+                    {
+                        //* The config holds no tabs in this case. Continuing with it would replay the journal onto an
+                        //* empty library, fold it into the next snapshot and write that over the library.
+                        Fancy::fancy.logTime().failure() << "Failed to read library, moving it and the journal..."
+                                                         << std::endl;
+
+                        if (!moveAside(LibrarySnapshot::getPath()) || !moveAside(Journal::getPath()))
+                        {
+                            keepLibrary = true;
+                        }
+                    }
                 }
+
+                data.set(conf.data);
+                journalSequence = conf.journalSequence;
+                Fancy::fancy.logTime().success() << "Config read" << std::endl;
+            }
+            catch (...)
+            {
+                Fancy::fancy.logTime().warning() << "Found possibly old config format, moving old config..."
+                                                 << std::endl;
+
+                moveAside(path);
             }
         }
         catch (const std::exception &e)
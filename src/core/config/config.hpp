@@ -1,20 +1,47 @@
 #pragma once
 #include <core/objects/data.hpp>
 #include <core/objects/settings.hpp>
+#include <cstdint>
+#include <map>
+#include <optional>
 #include <string>
 
 namespace Soundux
 {
     namespace Objects
     {
+        struct ConfigSnapshot
+        {
+            std::string config;
+            std::optional<std::string> library; //* Only set when the library is stored in binary
+
+            bool write() const;
+        };
+
         struct Config
         {
             Data data;
             Settings settings;
+            std::map<std::string, LoudnessInfo> loudness;
+            std::map<std::string, DirectoryManifest> manifests; //* Directory -> what it contained when last scanned
+            std::uint64_t journalSequence = 0; //* Last journal entry that is part of this config
+            //* Set when the stored library could neither be read nor moved aside, it is never written over then
+            bool keepLibrary = false;
 
-            void save();
+            bool save();
             void load();
-            static const std::string path;
+
+            static bool saveSettings(const Settings &);
+            static bool saveCache(const std::map<std::string, LoudnessInfo> &);
+            static bool saveManifests(const std::map<std::string, DirectoryManifest> &);
+
+            //* Serializes the library on the calling thread, the result can then be written out from anywhere
+            static ConfigSnapshot snapshot(const Data &, bool, std::uint64_t);
+
+            static const std::string path; //* Holds the library
+            static const std::string settingsPath;
+            static const std::string cachePath;
+            static const std::string manifestPath;
         };
     } // namespace Objects
 } // namespace Soundux
\ No newline at end of file
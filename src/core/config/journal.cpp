@@ -0,0 +1,367 @@
+#include "journal.hpp"
+#include "config.hpp"
+#include <core/global/globals.hpp>
+#include <fancy.hpp>
+#include <filesystem>
+#include <fstream>
+#include <helper/json/bindings.hpp>
+#include <helper/misc/misc.hpp>
+
+namespace Soundux::Objects
+{
+
+    static std::uint32_t getSoundIdCounter()
+    {
+        auto lock = Globals::gData.lock();
+        return Globals::gData.soundIdCounter;
+    }
+    static nlohmann::json soundChange(const Sound &sound)
+    {
+        return {{"id", sound.id},
+                {"hotkeys", sound.hotkeys},
+                {"isFavorite", sound.isFavorite},
+                {"localVolume", sound.localVolume},
+                {"remoteVolume", sound.remoteVolume}};
+    }
+    static void applySoundChange(Config &config, const nlohmann::json &change)
+    {
+        auto id = change.at("id").get<std::uint32_t>();
+        auto sound = config.data.modifySound(id, [&](Sound &target) {
+            change.at("hotkeys").get_to(target.hotkeys);
+
+            target.localVolume.reset();
+            if (change.at("localVolume").is_number())
+            {
+                target.localVolume = change.at("localVolume").get<int>();
+            }
+            target.remoteVolume.reset();
+            if (change.at("remoteVolume").is_number())
+            {
+                target.remoteVolume = change.at("remoteVolume").get<int>();
+            }
+        });
+
+        if (sound)
+        {
+            config.data.markFavorite(id, change.at("isFavorite").get<bool>());
+        }
+    }
+    static void applyChange(Config &config, const nlohmann::json &change)
+    {
+        const auto &type = change.at("type").get_ref<const std::string &>();
+
+        if (type == "sound")
+        {
+            applySoundChange(config, change);
+        }
+        else if (type == "sounds")
+        {
+            for (const auto &soundChange : change.at("sounds"))
+            {
+                applySoundChange(config, soundChange);
+            }
+        }
+        else if (type == "addTab")
+        {
+            config.data.addTab(change.at("tab").get<Tab>());
+            change.at("soundIdCounter").get_to(config.data.soundIdCounter);
+        }
+        else if (type == "setTab")
+        {
+            auto tab = change.at("tab").get<Tab>();
+            config.data.setTab(tab.id, tab);
+            change.at("soundIdCounter").get_to(config.data.soundIdCounter);
+        }
+        else if (type == "removeTab")
+        {
+            config.data.removeTabById(change.at("id").get<std::uint32_t>());
+        }
+        else if (type == "tabOrder")
+        {
+            std::vector<Tab> tabs;
+            for (const auto &id : change.at("order").get<std::vector<int>>())
+            {
+                if (auto tab = config.data.getTab(id); tab)
+                {
+                    tabs.emplace_back(std::move(*tab));
+                }
+            }
+            config.data.setTabs(tabs);
+        }
+        else
+        {
+            Fancy::fancy.logTime().warning() << "Unknown journal entry " << type << std::endl;
+        }
+    }
+
+    //* Not a static member, it would depend on the initialization order of Config::path
+    std::string Journal::getPath()
+    {
+        return (std::filesystem::path(Config::path).parent_path() / "journal.jsonl").u8string();
+    }
+
+    Journal::Journal()
+    {
+        handler = std::thread([this] { handle(); });
+    }
+    Journal::~Journal()
+    {
+        destroy();
+    }
+
+    void Journal::handle()
+    {
+        std::unique_lock lock(jobsMutex);
+        while (!stop || !jobs.empty())
+        {
+            cv.wait(lock, [&]() { return !jobs.empty() || stop; });
+
+            auto batch = std::move(jobs);
+            jobs.clear();
+
+            lock.unlock();
+            for (const auto &job : batch)
+            {
+                write(job);
+            }
+
+            //* One sync per batch, so a burst of changes does not cost a sync each
+            if (file && !batch.empty() && !Helpers::syncFile(file))
+            {
+                Fancy::fancy.logTime().warning() << "Failed to sync journal" << std::endl;
+            }
+            lock.lock();
+        }
+    }
+    void Journal::write(const Job &job)
+    {
+        if (job.snapshot)
+        {
+            if (!Config::snapshot(*job.snapshot, job.binaryLibrary, job.sequence).write())
+            {
+                Fancy::fancy.logTime().failure() << "Failed to compact journal" << std::endl;
+                return;
+            }
+
+            //* Everything written so far is part of the snapshot now
+            if (file)
+            {
+                std::fclose(file);
+                file = nullptr;
+            }
+
+            if (open("w"))
+            {
+                Fancy::fancy.logTime().success() << "Compacted journal" << std::endl;
+            }
+            return;
+        }
+
+        //* Entries that are already part of the snapshot are skipped on replay, so we can safely append to an old
+        //* journal in case truncating it failed
+        if (!file && !open("a"))
+        {
+            return;
+        }
+
+        if (std::fputs(job.content.c_str(), file) < 0)
+        {
+            Fancy::fancy.logTime().warning() << "Failed to append to journal" << std::endl;
+        }
+    }
+    bool Journal::open(const char *mode)
+    {
+        file = std::fopen(getPath().c_str(), mode);
+        if (!file)
+        {
+            if (!openFailed)
+            {
+                Fancy::fancy.logTime().failure()
+                    << "Failed to open journal, retrying with the next change" << std::endl;
+            }
+
+            openFailed = true;
+            return false;
+        }
+
+        openFailed = false;
+        return true;
+    }
+    void Journal::append(const std::string &change)
+    {
+        //* Callers hold the library across their change and this call, so entries are sequenced in the order the
+        //* changes were made. The library is always locked before the jobs, compaction needs both.
+        auto dataLock = Globals::gData.lock();
+        std::unique_lock lock(jobsMutex);
+        jobs.push_back({"{\"sequence\":" + std::to_string(++sequence) + ",\"change\":" + change + "}\n", std::nullopt});
+
+        if (++entries >= compactAfter)
+        {
+            compact(lock);
+        }
+
+        lock.unlock();
+        cv.notify_one();
+    }
+    void Journal::compact([[maybe_unused]] std::unique_lock<std::mutex> &lock)
+    {
+        if (Globals::gConfig.keepLibrary)
+        {
+            return;
+        }
+
+        //* The library is locked by our caller, so the copy contains exactly the entries up to `sequence`.
+        //* Serializing it is left to the journal thread.
+        jobs.push_back({{}, Data(Globals::gData), Globals::gSettings.binaryLibrary, sequence});
+        entries = 0;
+        needsCompaction = false;
+    }
+
+    void Journal::replay(Config &config)
+    {
+        TraceScope scope("Journal::replay");
+
+        std::lock_guard lock(jobsMutex);
+        sequence = config.journalSequence;
+
+        std::ifstream stream(getPath());
+        if (!stream)
+        {
+            return;
+        }
+
+        std::size_t replayed = 0;
+        for (std::string line; std::getline(stream, line);)
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+
+            needsCompaction = true;
+
+            auto entry = nlohmann::json::parse(line, nullptr, false);
+            if (entry.is_discarded() || entry.find("sequence") == entry.end() || entry.find("change") == entry.end())
+            {
+                //* Most likely an entry that was only partially written before a crash
+                Fancy::fancy.logTime().warning() << "Journal contains a damaged entry, ignoring the rest" << std::endl;
+                break;
+            }
+
+            auto entrySequence = entry.at("sequence").get<std::uint64_t>();
+            if (entrySequence <= config.journalSequence)
+            {
+                continue;
+            }
+
+            try
+            {
+                applyChange(config, entry.at("change"));
+                sequence = entrySequence;
+                replayed++;
+            }
+            catch (const std::exception &e)
+            {
+                Fancy::fancy.logTime().warning() << "Failed to replay journal entry " << entrySequence << ": "
+                                                 << e.what() << std::endl;
+            }
+        }
+
+        config.journalSequence = sequence;
+        if (replayed > 0)
+        {
+            Fancy::fancy.logTime().success() << "Replayed " << replayed << " journal entries" << std::endl;
+        }
+    }
+    void Journal::setup()
+    {
+        TraceScope scope("Journal::setup");
+
+        auto dataLock = Globals::gData.lock();
+        std::unique_lock lock(jobsMutex);
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(getPath()).parent_path(), ec);
+
+        if (!open("a"))
+        {
+            return;
+        }
+
+        //* Every session starts with an empty journal, this also gets rid of a damaged entry a crash left behind
+        if (needsCompaction)
+        {
+            compact(lock);
+        }
+
+        lock.unlock();
+        cv.notify_one();
+    }
+    void Journal::destroy()
+    {
+        if (!handler.joinable())
+        {
+            return;
+        }
+
+        stop = true;
+        cv.notify_all();
+        handler.join();
+
+        if (file)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+    void Journal::clear()
+    {
+        std::error_code ec;
+        std::filesystem::remove(getPath(), ec);
+
+        if (ec)
+        {
+            Fancy::fancy.logTime().warning() << "Failed to remove journal: " << ec.message() << std::endl;
+        }
+    }
+    std::uint64_t Journal::getSequence()
+    {
+        std::lock_guard lock(jobsMutex);
+        return sequence;
+    }
+
+    void Journal::onSoundChanged(const Sound &sound)
+    {
+        auto change = soundChange(sound);
+        change["type"] = "sound";
+
+        append(change.dump());
+    }
+    void Journal::onSoundsChanged(const std::vector<Sound> &sounds)
+    {
+        //* A single entry, so that large batches don't cause a compaction every thousand sounds
+        auto changes = nlohmann::json::array();
+        for (const auto &sound : sounds)
+        {
+            changes.push_back(soundChange(sound));
+        }
+
+        append(nlohmann::json{{"type", "sounds"}, {"sounds", changes}}.dump());
+    }
+    void Journal::onTabAdded(const Tab &tab)
+    {
+        append(nlohmann::json{{"type", "addTab"}, {"tab", tab}, {"soundIdCounter", getSoundIdCounter()}}.dump());
+    }
+    void Journal::onTabChanged(const Tab &tab)
+    {
+        append(nlohmann::json{{"type", "setTab"}, {"tab", tab}, {"soundIdCounter", getSoundIdCounter()}}.dump());
+    }
+    void Journal::onTabRemoved(std::uint32_t id)
+    {
+        append(nlohmann::json{{"type", "removeTab"}, {"id", id}}.dump());
+    }
+    void Journal::onTabsReordered(const std::vector<int> &order)
+    {
+        append(nlohmann::json{{"type", "tabOrder"}, {"order", order}}.dump());
+    }
+} // namespace Soundux::Objects
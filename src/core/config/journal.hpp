@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <core/config/config.hpp>
+#include <core/objects/objects.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+
+        //* Append-only log of every change made to the library. Entries are written and synced to disk on a background
+        //* thread and are periodically folded into a new config snapshot, a crash only loses what was not yet synced.
+        class Journal
+        {
+            struct Job
+            {
+                std::string content;
+                //* A copy of the library to fold the journal into, it is serialized on the journal thread
+                std::optional<Data> snapshot;
+                bool binaryLibrary = false;
+                std::uint64_t sequence = 0;
+            };
+
+            std::FILE *file = nullptr;
+            bool openFailed = false; //* So that a journal we can't open is only reported once
+            std::uint64_t sequence = 0;
+            std::size_t entries = 0; //* Since the last snapshot
+            bool needsCompaction = false;
+
+            std::vector<Job> jobs;
+            std::mutex jobsMutex;
+
+            std::condition_variable cv;
+            std::atomic<bool> stop = false;
+            std::thread handler;
+
+          private:
+            void handle();
+            void write(const Job &);
+            bool open(const char *);
+            void append(const std::string &);
+            void compact(std::unique_lock<std::mutex> &);
+
+          public:
+            Journal();
+            ~Journal();
+
+            //* Applies every entry that is not yet part of the given config
+            void replay(Config &);
+            //* Called once the globals hold the replayed state
+            void setup();
+            //* Writes out everything that is still pending and stops the background thread
+            void destroy();
+            //* Called after a full config with the current sequence was saved
+            void clear();
+
+            std::uint64_t getSequence();
+            static std::string getPath();
+
+            void onSoundChanged(const Sound &);
+            void onSoundsChanged(const std::vector<Sound> &);
+            void onTabAdded(const Tab &);
+            void onTabChanged(const Tab &);
+            void onTabRemoved(std::uint32_t);
+            void onTabsReordered(const std::vector<int> &);
+
+            static constexpr std::size_t compactAfter = 1000;
+        };
+    } // namespace Objects
+} // namespace Soundux
@@ -0,0 +1,349 @@
+#include "library.hpp"
+#include "config.hpp"
+#include <cstring>
+#include <fancy.hpp>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Soundux::Objects
+{
+    //* Everything is stored in native byte order, a snapshot from a machine with a different one fails the magic check
+    static constexpr std::uint32_t magic = 0x424C5853; //* "SXLB"
+
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t journalSequence;
+        std::uint32_t soundIdCounter;
+        std::uint32_t tabCount;
+        std::uint32_t soundCount;
+        std::uint32_t hotkeyCount;
+        std::uint64_t stringsSize;
+    };
+    struct TabRecord
+    {
+        std::uint32_t name;
+        std::uint32_t nameLength;
+        std::uint32_t path;
+        std::uint32_t pathLength;
+        std::uint32_t firstSound;
+        std::uint32_t soundCount;
+        std::uint32_t sortMode;
+        std::uint32_t reserved;
+    };
+    struct SoundRecord
+    {
+        std::uint64_t modifiedDate;
+        std::uint32_t id;
+        std::uint32_t name;
+        std::uint32_t nameLength;
+        std::uint32_t path;
+        std::uint32_t pathLength;
+        std::uint32_t firstHotkey;
+        std::uint32_t hotkeyCount;
+        std::uint32_t flags;
+        std::int32_t localVolume;
+        std::int32_t remoteVolume;
+    };
+
+    static_assert(sizeof(Header) == 40 && sizeof(TabRecord) == 32 && sizeof(SoundRecord) == 48,
+                  "Snapshot records must not contain padding");
+    static_assert(sizeof(int) == sizeof(std::int32_t), "Hotkeys are copied as is");
+
+    enum SoundFlags : std::uint32_t
+    {
+        Favorite = 1U << 0U,
+        LocalVolume = 1U << 1U,
+        RemoteVolume = 1U << 2U,
+    };
+
+    class MappedFile
+    {
+        const char *content = nullptr;
+        std::size_t size = 0;
+#if defined(__linux__)
+        void *mapping = nullptr;
+#else
+        std::string buffer;
+#endif
+
+      public:
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        explicit MappedFile(const std::string &path)
+        {
+#if defined(__linux__)
+            auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+            if (fd < 0)
+            {
+                return;
+            }
+
+            struct stat info
+            {
+            };
+            if (fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                size = static_cast<std::size_t>(info.st_size);
+                mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (mapping == MAP_FAILED) // NOLINT
+                {
+                    mapping = nullptr;
+                    size = 0;
+                }
+                else
+                {
+                    content = static_cast<const char *>(mapping);
+                }
+            }
+
+            close(fd);
+#else
+            std::ifstream stream(path, std::ios::binary);
+            if (stream)
+            {
+                buffer.assign((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+                content = buffer.data();
+                size = buffer.size();
+            }
+#endif
+        }
+        ~MappedFile()
+        {
+#if defined(__linux__)
+            if (mapping)
+            {
+                munmap(mapping, size);
+            }
+#endif
+        }
+
+        const char *data() const
+        {
+            return content;
+        }
+        std::size_t length() const
+        {
+            return size;
+        }
+    };
+
+    template <typename T> static void append(std::string &out, const T *items, std::size_t count)
+    {
+        out.append(reinterpret_cast<const char *>(items), count * sizeof(T));
+    }
+
+    std::string LibrarySnapshot::getPath()
+    {
+        return (std::filesystem::path(Config::path).parent_path() / "library.bin").u8string();
+    }
+
+    std::string LibrarySnapshot::serialize(const Data &data, std::uint64_t journalSequence)
+    {
+        std::vector<TabRecord> tabs;
+        std::vector<SoundRecord> sounds;
+        std::vector<std::int32_t> hotkeys;
+        std::string strings;
+
+        auto addString = [&](const std::string &string) {
+            auto offset = static_cast<std::uint32_t>(strings.size());
+            strings.append(string);
+            return offset;
+        };
+
+        tabs.reserve(data.tabs.size());
+        for (const auto &tab : data.tabs)
+        {
+            TabRecord record{};
+            record.name = addString(tab.name);
+            record.nameLength = static_cast<std::uint32_t>(tab.name.size());
+            record.path = addString(tab.path);
+            record.pathLength = static_cast<std::uint32_t>(tab.path.size());
+            record.firstSound = static_cast<std::uint32_t>(sounds.size());
+            record.soundCount = static_cast<std::uint32_t>(tab.sounds.size());
+            record.sortMode = static_cast<std::uint32_t>(tab.sortMode);
+
+            for (const auto &sound : tab.sounds)
+            {
+                SoundRecord soundRecord{};
+                soundRecord.id = sound.id;
+                soundRecord.modifiedDate = sound.modifiedDate;
+                soundRecord.name = addString(sound.name);
+                soundRecord.nameLength = static_cast<std::uint32_t>(sound.name.size());
+                soundRecord.path = addString(sound.path);
+                soundRecord.pathLength = static_cast<std::uint32_t>(sound.path.size());
+                soundRecord.firstHotkey = static_cast<std::uint32_t>(hotkeys.size());
+                soundRecord.hotkeyCount = static_cast<std::uint32_t>(sound.hotkeys.size());
+
+                hotkeys.insert(hotkeys.end(), sound.hotkeys.begin(), sound.hotkeys.end());
+
+                if (sound.isFavorite)
+                {
+                    soundRecord.flags |= SoundFlags::Favorite;
+                }
+                if (sound.localVolume)
+                {
+                    soundRecord.flags |= SoundFlags::LocalVolume;
+                    soundRecord.localVolume = *sound.localVolume;
+                }
+                if (sound.remoteVolume)
+                {
+                    soundRecord.flags |= SoundFlags::RemoteVolume;
+                    soundRecord.remoteVolume = *sound.remoteVolume;
+                }
+
+                sounds.emplace_back(soundRecord);
+            }
+
+            tabs.emplace_back(record);
+        }
+
+        Header header{};
+        header.magic = magic;
+        header.version = version;
+        header.journalSequence = journalSequence;
+        header.soundIdCounter = data.soundIdCounter;
+        header.tabCount = static_cast<std::uint32_t>(tabs.size());
+        header.soundCount = static_cast<std::uint32_t>(sounds.size());
+        header.hotkeyCount = static_cast<std::uint32_t>(hotkeys.size());
+        header.stringsSize = strings.size();
+
+        std::string rtn;
+        rtn.reserve(sizeof(Header) + tabs.size() * sizeof(TabRecord) + sounds.size() * sizeof(SoundRecord) +
+                    hotkeys.size() * sizeof(std::int32_t) + strings.size());
+
+        append(rtn, &header, 1);
+        append(rtn, tabs.data(), tabs.size());
+        append(rtn, sounds.data(), sounds.size());
+        append(rtn, hotkeys.data(), hotkeys.size());
+        rtn.append(strings);
+
+        return rtn;
+    }
+
+    std::optional<std::uint64_t> LibrarySnapshot::load(Data &data)
+    {
+        MappedFile file(getPath());
+        if (!file.data() || file.length() < sizeof(Header))
+        {
+            return std::nullopt;
+        }
+
+        Header header{};
+        std::memcpy(&header, file.data(), sizeof(Header));
+
+        if (header.magic != magic || header.version != version)
+        {
+            Fancy::fancy.logTime().warning() << "Ignoring library snapshot with unknown format" << std::endl;
+            return std::nullopt;
+        }
+
+        const auto tabsOffset = sizeof(Header);
+        const auto soundsOffset = tabsOffset + static_cast<std::uint64_t>(header.tabCount) * sizeof(TabRecord);
+        const auto hotkeysOffset = soundsOffset + static_cast<std::uint64_t>(header.soundCount) * sizeof(SoundRecord);
+        const auto stringsOffset =
+            hotkeysOffset + static_cast<std::uint64_t>(header.hotkeyCount) * sizeof(std::int32_t);
+
+        if (stringsOffset + header.stringsSize != file.length())
+        {
+            Fancy::fancy.logTime().warning() << "Library snapshot is truncated" << std::endl;
+            return std::nullopt;
+        }
+
+        const auto *strings = file.data() + stringsOffset;
+        auto getString = [&](std::uint32_t offset, std::uint32_t length) {
+            if (static_cast<std::uint64_t>(offset) + length > header.stringsSize)
+            {
+                throw std::out_of_range("String out of bounds");
+            }
+            return std::string(strings + offset, length);
+        };
+
+        std::vector<Tab> tabs;
+        try
+        {
+            tabs.resize(header.tabCount);
+            for (std::uint32_t i = 0; header.tabCount > i; i++)
+            {
+                TabRecord record{};
+                std::memcpy(&record, file.data() + tabsOffset + i * sizeof(TabRecord), sizeof(TabRecord));
+
+                if (static_cast<std::uint64_t>(record.firstSound) + record.soundCount > header.soundCount)
+                {
+                    throw std::out_of_range("Sound out of bounds");
+                }
+
+                auto &tab = tabs[i];
+                tab.id = i;
+                tab.name = getString(record.name, record.nameLength);
+                tab.path = getString(record.path, record.pathLength);
+                tab.sortMode = static_cast<Enums::SortMode>(record.sortMode);
+                tab.sounds.resize(record.soundCount);
+
+                for (std::uint32_t j = 0; record.soundCount > j; j++)
+                {
+                    SoundRecord soundRecord{};
+                    std::memcpy(&soundRecord,
+                                file.data() + soundsOffset + (record.firstSound + j) * sizeof(SoundRecord),
+                                sizeof(SoundRecord));
+
+                    if (static_cast<std::uint64_t>(soundRecord.firstHotkey) + soundRecord.hotkeyCount >
+                        header.hotkeyCount)
+                    {
+                        throw std::out_of_range("Hotkey out of bounds");
+                    }
+
+                    auto &sound = tab.sounds[j];
+                    sound.id = soundRecord.id;
+                    sound.modifiedDate = soundRecord.modifiedDate;
+                    sound.name = getString(soundRecord.name, soundRecord.nameLength);
+                    sound.path = getString(soundRecord.path, soundRecord.pathLength);
+                    sound.isFavorite = soundRecord.flags & SoundFlags::Favorite;
+
+                    sound.hotkeys.resize(soundRecord.hotkeyCount);
+                    std::memcpy(sound.hotkeys.data(),
+                                file.data() + hotkeysOffset + soundRecord.firstHotkey * sizeof(std::int32_t),
+                                soundRecord.hotkeyCount * sizeof(std::int32_t));
+
+                    if (soundRecord.flags & SoundFlags::LocalVolume)
+                    {
+                        sound.localVolume = soundRecord.localVolume;
+                    }
+                    if (soundRecord.flags & SoundFlags::RemoteVolume)
+                    {
+                        sound.remoteVolume = soundRecord.remoteVolume;
+                    }
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            Fancy::fancy.logTime().warning() << "Library snapshot seems corrupted: " << e.what() << std::endl;
+            return std::nullopt;
+        }
+
+        data.tabs = std::move(tabs);
+        data.soundIdCounter = header.soundIdCounter;
+
+        Fancy::fancy.logTime().success() << "Loaded " << header.soundCount << " sounds from library snapshot"
+                                         << std::endl;
+        return header.journalSequence;
+    }
+
+    void LibrarySnapshot::remove()
+    {
+        std::error_code ec;
+        std::filesystem::remove(getPath(), ec);
+    }
+} // namespace Soundux::Objects
@@ -0,0 +1,26 @@
+#pragma once
+#include <core/objects/data.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        //* Binary snapshot of all tabs and sounds. It consists of a header, fixed-width tab and sound records, a table
+        //* of hotkeys and a table of strings the records point into. Loading it is a single pass over a mapped file.
+        class LibrarySnapshot
+        {
+          public:
+            static constexpr std::uint32_t version = 1;
+
+            static std::string getPath();
+            static std::string serialize(const Data &, std::uint64_t);
+
+            //* Fills in the tabs of the given data and returns the journal sequence the snapshot was taken at
+            static std::optional<std::uint64_t> load(Data &);
+            static void remove();
+        };
+    } // namespace Objects
+} // namespace Soundux
@@ -0,0 +1,140 @@
+#include "saver.hpp"
+#include "config.hpp"
+#include <core/global/globals.hpp>
+#include <algorithm>
+#include <fancy.hpp>
+#include <utility>
+
+namespace Soundux::Objects
+{
+    Saver::Saver()
+    {
+        handler = std::thread([this] { handle(); });
+    }
+    Saver::~Saver()
+    {
+        destroy();
+    }
+
+    void Saver::Deadline::postpone()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!since)
+        {
+            since = now;
+        }
+
+        at = std::min(now + delay, *since + maxDelay);
+    }
+    bool Saver::Deadline::isDue(std::chrono::steady_clock::time_point now) const
+    {
+        return since && at <= now;
+    }
+
+    bool Saver::isPending() const
+    {
+        return settingsDeadline.since || cacheDeadline.since || manifestsDeadline.since;
+    }
+    std::chrono::steady_clock::time_point Saver::nextDeadline() const
+    {
+        auto next = std::chrono::steady_clock::time_point::max();
+        for (const auto *deadline : {&settingsDeadline, &cacheDeadline, &manifestsDeadline})
+        {
+            if (deadline->since)
+            {
+                next = std::min(next, deadline->at);
+            }
+        }
+
+        return next;
+    }
+    void Saver::handle()
+    {
+        std::unique_lock lock(mutex);
+        while (!stop)
+        {
+            cv.wait(lock, [&]() { return isPending() || stop; });
+
+            while (!stop && std::chrono::steady_clock::now() < nextDeadline())
+            {
+                cv.wait_until(lock, nextDeadline());
+            }
+
+            if (stop)
+            {
+                break;
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            auto take = [now](Deadline &deadline) {
+                if (!deadline.isDue(now))
+                {
+                    return false;
+                }
+
+                deadline.since.reset();
+                return true;
+            };
+
+            std::optional<Settings> dirtySettings;
+            if (take(settingsDeadline))
+            {
+                dirtySettings = std::exchange(settings, std::nullopt);
+            }
+            auto dirtyCache = take(cacheDeadline);
+            auto dirtyManifests = take(manifestsDeadline);
+
+            lock.unlock();
+            if (dirtySettings && !Config::saveSettings(*dirtySettings))
+            {
+                Fancy::fancy.logTime().warning() << "Failed to save settings" << std::endl;
+            }
+            if (dirtyCache && !Config::saveCache(Globals::gLoudness.getCache()))
+            {
+                Fancy::fancy.logTime().warning() << "Failed to save cache" << std::endl;
+            }
+            if (dirtyManifests && !Config::saveManifests(Globals::gScanner.getCache()))
+            {
+                Fancy::fancy.logTime().warning() << "Failed to save scan manifests" << std::endl;
+            }
+            lock.lock();
+        }
+    }
+    void Saver::destroy()
+    {
+        if (!handler.joinable())
+        {
+            return;
+        }
+
+        stop = true;
+        cv.notify_all();
+        handler.join();
+    }
+
+    void Saver::markSettingsDirty(const Settings &newSettings)
+    {
+        {
+            std::lock_guard lock(mutex);
+            settings = newSettings;
+            settingsDeadline.postpone();
+        }
+        cv.notify_one();
+    }
+    void Saver::markCacheDirty()
+    {
+        {
+            std::lock_guard lock(mutex);
+            cacheDeadline.postpone();
+        }
+        cv.notify_one();
+    }
+    void Saver::markManifestsDirty()
+    {
+        {
+            std::lock_guard lock(mutex);
+            manifestsDeadline.postpone();
+        }
+        cv.notify_one();
+    }
+} // namespace Soundux::Objects
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <core/objects/settings.hpp>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        //* Persists the settings and the cache independently of the library. Every change pushes the write of its kind
+        //* back a bit, so a burst of changes (e.g. dragging a volume slider) only results in a single small write. A
+        //* steady stream of changes is still written once `maxDelay` passed since the first unsaved one.
+        class Saver
+        {
+            struct Deadline
+            {
+                //* When the first change that was not written yet happened
+                std::optional<std::chrono::steady_clock::time_point> since;
+                std::chrono::steady_clock::time_point at;
+
+                void postpone();
+                bool isDue(std::chrono::steady_clock::time_point) const;
+            };
+
+            std::optional<Settings> settings;
+            Deadline settingsDeadline;
+            Deadline cacheDeadline;
+            Deadline manifestsDeadline;
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::atomic<bool> stop = false;
+            std::thread handler;
+
+          private:
+            void handle();
+            bool isPending() const;
+            std::chrono::steady_clock::time_point nextDeadline() const;
+
+          public:
+            Saver();
+            ~Saver();
+
+            //* Drops pending writes, the config is saved as a whole on exit anyway
+            void destroy();
+
+            void markSettingsDirty(const Settings &);
+            void markCacheDirty();
+            void markManifestsDirty();
+
+            static constexpr auto delay = std::chrono::seconds(2);
+            static constexpr auto maxDelay = std::chrono::seconds(10);
+        };
+    } // namespace Objects
+} // namespace Soundux
@@ -59,5 +59,20 @@ namespace Soundux
             PipeWire,
             PulseAudio,
         };
+
+        enum class LatencyMode : std::uint8_t
+        {
+            Default, //* 100ms
+            Low,     //* 20ms
+            VeryLow, //* 10ms
+            Lowest,  //* 5ms
+            Auto,
+        };
+
+        enum class StealingPolicy : std::uint8_t
+        {
+            Oldest,
+            Quietest,
+        };
     } // namespace Enums
 } // namespace Soundux
\ No newline at end of file
@@ -1,11 +1,14 @@
 #pragma once
 #include <helper/audio/audio.hpp>
+#include <helper/audio/loudness/loudness.hpp>
 #if defined(__linux__)
 #include <helper/audio/linux/backend.hpp>
 #elif defined(_WIN32)
 #include <helper/audio/windows/winsound.hpp>
 #endif
 #include <core/config/config.hpp>
+#include <core/config/journal.hpp>
+#include <core/config/saver.hpp>
 #include <core/hotkeys/hotkeys.hpp>
 #include <core/objects/data.hpp>
 #include <core/objects/objects.hpp>
@@ -13,6 +16,8 @@
 #include <guard.hpp>
 #include <helper/icons/icons.hpp>
 #include <helper/queue/queue.hpp>
+#include <helper/scan/scanner.hpp>
+#include <helper/trace/trace.hpp>
 #include <helper/ytdl/youtube-dl.hpp>
 #include <memory>
 #include <ui/ui.hpp>
@@ -24,6 +29,7 @@ namespace Soundux
     {
         inline Objects::Data gData;
         inline Objects::Audio gAudio;
+        inline Objects::Loudness gLoudness;
 #if defined(__linux__)
         inline std::shared_ptr<Objects::IconFetcher> gIcons;
         inline std::shared_ptr<Objects::AudioBackend> gAudioBackend;
@@ -31,7 +37,11 @@ namespace Soundux
         inline std::shared_ptr<Objects::WinSound> gWinSound;
 #endif
         inline Objects::Queue gQueue;
+        inline Objects::Scanner gScanner;
+        inline Objects::Tracer gTracer;
         inline Objects::Config gConfig;
+        inline Objects::Journal gJournal;
+        inline Objects::Saver gSaver;
         inline Objects::YoutubeDl gYtdl;
         inline Objects::Hotkeys gHotKeys;
         inline Objects::Settings gSettings;
@@ -39,7 +49,8 @@ namespace Soundux
 
         inline std::shared_ptr<guardpp::guard> gGuard;
 
-        /* Allows for fast & easy sound access, is populated on start up */
+        /* Allows for fast & easy sound access, is populated on start up. Points into gData, so it may only be used
+         * while holding gData.lock() */
         inline sxl::var_guard<std::map<std::uint32_t, std::reference_wrapper<Objects::Sound>>> gSounds;
         inline sxl::var_guard<std::map<std::uint32_t, std::reference_wrapper<Objects::Sound>>> gFavorites;
     } // namespace Globals
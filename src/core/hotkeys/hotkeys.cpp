@@ -144,6 +144,7 @@ namespace Soundux
             }
             else
             {
+                auto lock = Globals::gData.lock();
                 auto scopedSounds = Globals::gSounds.scoped();
                 bestMatch = getBestMatch(*scopedSounds, pressedKeys);
             }
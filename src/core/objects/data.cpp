@@ -4,8 +4,24 @@
 
 namespace Soundux::Objects
 {
+    Data::Data(const Data &other)
+    {
+        std::lock_guard lock(other.mutex);
+
+        tabs = other.tabs;
+        isOnFavorites = other.isOnFavorites;
+        width = other.width;
+        height = other.height;
+        soundIdCounter = other.soundIdCounter;
+    }
+    std::unique_lock<std::recursive_mutex> Data::lock() const
+    {
+        return std::unique_lock(mutex);
+    }
     Tab Data::addTab(Tab tab)
     {
+        std::lock_guard lock(mutex);
+
         tab.id = tabs.size();
         tabs.emplace_back(tab);
 
@@ -22,6 +38,8 @@ namespace Soundux::Objects
     }
     void Data::removeTabById(const std::uint32_t &index)
     {
+        std::lock_guard lock(mutex);
+
         if (tabs.size() > index)
         {
             auto &tab = tabs.at(index);
@@ -48,6 +66,8 @@ namespace Soundux::Objects
     }
     void Data::setTabs(const std::vector<Tab> &newTabs)
     {
+        std::lock_guard lock(mutex);
+
         tabs = newTabs;
         Globals::gSounds->clear();
         Globals::gFavorites->clear();
@@ -68,10 +88,14 @@ namespace Soundux::Objects
     }
     std::vector<Tab> Data::getTabs() const
     {
+        std::lock_guard lock(mutex);
+
         return tabs;
     }
     std::optional<Tab> Data::getTab(const std::uint32_t &id) const
     {
+        std::lock_guard lock(mutex);
+
         if (tabs.size() > id)
         {
             return tabs.at(id);
@@ -80,12 +104,19 @@ namespace Soundux::Objects
         Fancy::fancy.logTime().warning() << "Tried to access non existent tab " << id << std::endl;
         return std::nullopt;
     }
-    std::optional<std::reference_wrapper<Sound>> Data::getSound(const std::uint32_t &id)
+    std::optional<Sound> Data::getSound(const std::uint32_t &id)
     {
+        return modifySound(id, [](Sound &) {});
+    }
+    std::optional<Sound> Data::modifySound(const std::uint32_t &id, const std::function<void(Sound &)> &modify)
+    {
+        std::lock_guard lock(mutex);
         auto scopedSounds = Globals::gSounds.scoped();
-        if (scopedSounds->find(id) != scopedSounds->end())
+
+        if (auto sound = scopedSounds->find(id); sound != scopedSounds->end())
         {
-            return scopedSounds->at(id);
+            modify(sound->second.get());
+            return sound->second.get();
         }
 
         Fancy::fancy.logTime().warning() << "Tried to access non existent sound " << id << std::endl;
@@ -93,6 +124,8 @@ namespace Soundux::Objects
     }
     std::optional<Tab> Data::setTab(const std::uint32_t &id, const Tab &tab)
     {
+        std::lock_guard lock(mutex);
+
         if (tabs.size() > id)
         {
             auto &realTab = tabs.at(id);
@@ -124,6 +157,8 @@ namespace Soundux::Objects
     }
     void Data::set(const Data &other)
     {
+        std::scoped_lock lock(mutex, other.mutex);
+
         tabs = other.tabs;
         width = other.width;
         height = other.height;
@@ -149,13 +184,15 @@ namespace Soundux::Objects
     }
     void Data::markFavorite(const std::uint32_t &id, bool favourite)
     {
-        auto sound = getSound(id);
-        if (sound)
+        std::lock_guard lock(mutex);
+        auto scopedSounds = Globals::gSounds.scoped();
+
+        if (auto sound = scopedSounds->find(id); sound != scopedSounds->end())
         {
-            sound->get().isFavorite = favourite;
+            sound->second.get().isFavorite = favourite;
             if (favourite)
             {
-                Globals::gFavorites->insert({id, sound->get()});
+                Globals::gFavorites->insert({id, sound->second});
             }
             else
             {
@@ -169,6 +206,7 @@ namespace Soundux::Objects
     }
     std::vector<std::uint32_t> Data::getFavoriteIds()
     {
+        std::lock_guard lock(mutex);
         auto scopedFavorites = Globals::gFavorites.scoped();
 
         std::vector<std::uint32_t> rtn;
@@ -183,6 +221,7 @@ namespace Soundux::Objects
     }
     std::vector<Sound> Data::getFavorites()
     {
+        std::lock_guard lock(mutex);
         auto scopedFavorites = Globals::gFavorites.scoped();
 
         std::vector<Sound> rtn;
@@ -197,6 +236,8 @@ namespace Soundux::Objects
     }
     bool Data::doesTabExist(const std::string &path)
     {
+        std::lock_guard lock(mutex);
+
         auto it = std::find_if(tabs.begin(), tabs.end(), [&](const auto &tab) { return tab.path == path; });
         return it != tabs.end();
     }
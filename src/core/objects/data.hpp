@@ -1,6 +1,8 @@
 #pragma once
 #include "objects.hpp"
 #include <cstdint>
+#include <functional>
+#include <mutex>
 #include <optional>
 #include <vector>
 
@@ -13,18 +15,28 @@ namespace Soundux
 {
     namespace Objects
     {
+        class LibrarySnapshot;
         class Data
         {
             template <typename, typename> friend struct nlohmann::adl_serializer;
+            friend class LibrarySnapshot;
 
           private:
             std::vector<Tab> tabs;
+            //* Guards the tabs and the soundIdCounter as well as gSounds and gFavorites, which point into the tabs
+            mutable std::recursive_mutex mutex;
 
           public:
             bool isOnFavorites = false;
             int width = 1280, height = 720;
             std::uint32_t soundIdCounter = 0;
 
+            Data() = default;
+            Data(const Data &);
+
+            //* Held by callers that read and then modify the library, so that nothing changes in between
+            std::unique_lock<std::recursive_mutex> lock() const;
+
             std::vector<Tab> getTabs() const;
             void setTabs(const std::vector<Tab> &);
             bool doesTabExist(const std::string &);
@@ -34,7 +46,9 @@ namespace Soundux
             void removeTabById(const std::uint32_t &);
 
             std::optional<Tab> getTab(const std::uint32_t &) const;
-            std::optional<std::reference_wrapper<Sound>> getSound(const std::uint32_t &);
+            std::optional<Sound> getSound(const std::uint32_t &);
+            //* Returns the sound as it is after the modification
+            std::optional<Sound> modifySound(const std::uint32_t &, const std::function<void(Sound &)> &);
 
             std::vector<Sound> getFavorites();
             std::vector<std::uint32_t> getFavoriteIds();
@@ -22,6 +22,44 @@ namespace Soundux
 
             std::optional<int> localVolume;
             std::optional<int> remoteVolume;
+
+            //* Hash of the file contents, shared by every copy of the same file. Not stored, it is taken from the
+            //* scan manifests and is 0 until the file was hashed.
+            std::uint64_t contentId = 0;
+        };
+
+        struct HotkeyUpdate
+        {
+            std::uint32_t id;
+            std::vector<int> hotkeys;
+        };
+        struct VolumeUpdate
+        {
+            std::uint32_t id;
+            std::optional<int> volume; //* Resets the custom volume if empty
+        };
+
+        struct LoudnessInfo
+        {
+            std::uint64_t modifiedDate = 0;
+            double integrated = 0; //* In LUFS
+            double truePeak = 0;   //* In dBTP
+        };
+
+        struct ScanEntry
+        {
+            std::string path;
+            std::uint64_t inode = 0; //* Not available on windows
+            std::uint64_t size = 0;
+            std::uint64_t modifiedDate = 0;
+            std::uint64_t contentHash = 0; //* 0 until the contents were hashed
+        };
+        struct DirectoryManifest
+        {
+            //* Of the directory itself, which changes whenever an entry is added, removed or renamed
+            std::uint64_t modifiedDate = 0;
+            std::vector<ScanEntry> entries;
+            std::vector<std::string> directories;
         };
 
         struct Tab
@@ -13,6 +13,8 @@ namespace Soundux
             Enums::BackendType audioBackend = Enums::BackendType::PulseAudio;
             Enums::ViewMode viewMode = Enums::ViewMode::List;
             Enums::Theme theme = Enums::Theme::System;
+            Enums::LatencyMode latencyMode = Enums::LatencyMode::Default;
+            Enums::StealingPolicy stealingPolicy = Enums::StealingPolicy::Oldest;
             std::optional<std::string> language;
 
             std::vector<int> pushToTalkKeys;
@@ -20,18 +22,29 @@ namespace Soundux
 
             std::vector<std::string> outputs;
             std::uint32_t selectedTab = 0;
+            std::uint32_t decodeAhead = 500; //* In milliseconds
+            std::uint32_t maxVoices = 0;     //* Per playback device, 0 means unlimited
+            std::uint32_t maxScanDepth = 8;  //* Only used for recursive tabs, 0 only scans the tab directory itself
 
             int remoteVolume = 100;
             int localVolume = 50;
             bool syncVolumes = false;
 
+            bool normalizeLoudness = false;
+            int targetLoudness = -18; //* In LUFS
+
             bool allowMultipleOutputs = false;
             bool useAsDefaultDevice = false;
             bool muteDuringPlayback = false;
             bool allowOverlapping = true;
+            bool restartOnRetrigger = false;
+            bool nativeOutput = false;         //* Only used on PipeWire
+            bool inProcessPassthrough = false; //* Only used on PulseAudio
             bool minimizeToTray = false;
             bool tabHotkeysOnly = false;
             bool deleteToTrash = true;
+            bool recursiveTabs = false; //* Tabs contain the sounds of all of their subdirectories
+            bool binaryLibrary = false; //* Store tabs and sounds in a binary snapshot instead of the config
         };
     } // namespace Objects
 } // namespace Soundux
\ No newline at end of file
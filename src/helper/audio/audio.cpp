@@ -6,6 +6,10 @@
 #endif
 
 #define MINIAUDIO_IMPLEMENTATION
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <miniaudio.h>
 
 namespace Soundux::Objects
@@ -16,9 +20,13 @@ namespace Soundux::Objects
 
     void Audio::setup()
     {
+        TraceScope scope("Audio::setup");
+
 #if defined(__linux__)
         nullSink = std::nullopt;
 #endif
+        //* Setup is repeated when the sinks were changed, in which case the cached devices are outdated
+        invalidateDevices();
         for (const auto &device : getAudioDevices())
         {
             if (device.isDefault)
@@ -32,21 +40,410 @@ namespace Soundux::Objects
             }
 #endif
         }
+
+#if defined(__linux__)
+        if (Globals::gAudioBackend)
+        {
+            if (auto native = Globals::gAudioBackend->getNativeOutput(); native)
+            {
+                AudioDevice device{};
+                device.isNative = true;
+                device.name = "soundux_sink";
+                device.channels = native->channels;
+                device.sampleRate = native->sampleRate;
+
+                nullSink = device;
+                Fancy::fancy.logTime().message()
+                    << "Using native output at " << native->sampleRate << "Hz" << std::endl;
+            }
+        }
+#endif
+
+        tuneLatency();
+
+        if (!decodeThread.joinable())
+        {
+            stopDecoder = false;
+            decodeThread = std::thread([this] { decodeLoop(); });
+        }
+
+        if (std::getenv("SOUNDUX_DEBUG") != nullptr && !statsLogger.joinable()) // NOLINT
+        {
+            stopStatsLogger = false;
+            statsLogger = std::thread([this] { logStats(); });
+        }
     }
     void Audio::destroy()
     {
         stopAll();
+
+        if (decodeThread.joinable())
+        {
+            {
+                std::lock_guard lock(decodeMutex);
+                stopDecoder = true;
+            }
+            decodeCv.notify_all();
+            decodeThread.join();
+        }
+
+        if (statsLogger.joinable())
+        {
+            {
+                std::lock_guard lock(statsMutex);
+                stopStatsLogger = true;
+            }
+            statsCv.notify_all();
+            statsLogger.join();
+        }
+
+        std::lock_guard lock(devicesMutex);
+        if (hasContext)
+        {
+            ma_context_uninit(&context);
+            hasContext = false;
+        }
+        devices.clear();
+        deviceIndex.clear();
+        devicesChanged = true;
+    }
+    void Audio::notifyDecoder()
+    {
+        {
+            std::lock_guard lock(decodeMutex);
+            decodePending = true;
+        }
+        decodeCv.notify_one();
+    }
+    void Audio::decodeLoop()
+    {
+        std::unique_lock lock(decodeMutex);
+        while (!stopDecoder)
+        {
+            decodePending = false;
+            lock.unlock();
+
+            std::vector<std::shared_ptr<PlayingSound>> sounds;
+            {
+                auto scoped = playingSounds.scoped();
+                for (const auto &[id, sound] : *scoped)
+                {
+                    sounds.emplace_back(sound);
+                }
+            }
+
+            for (const auto &sound : sounds)
+            {
+                decodeAhead(*sound);
+                report(*sound);
+            }
+
+            if (periodSizeIncreased.exchange(false))
+            {
+                Fancy::fancy.logTime().warning()
+                    << "Detected underrun, increasing period size to " << autoPeriodSize.load() << "ms" << std::endl;
+            }
+
+            //* A quarter of the read-ahead distance leaves plenty of headroom for slow disks or expensive decoders
+            auto interval = std::clamp<std::uint32_t>(Globals::gSettings.decodeAhead / 4, 5, 50);
+
+            lock.lock();
+            decodeCv.wait_for(lock, std::chrono::milliseconds(interval),
+                              [this] { return stopDecoder || decodePending; });
+        }
+    }
+    void Audio::decodeAhead(PlayingSound &sound)
+    {
+        std::lock_guard lock(*sound.decoderMutex);
+
+        auto *decoder = sound.raw.decoder.load();
+        auto *buffer = sound.raw.buffer.load();
+        if (!decoder || !buffer)
+        {
+            return;
+        }
+
+        if (sound.seekState == SeekState::Requested)
+        {
+            //* We won't write to the buffer until the callback has flushed it
+            ma_decoder_seek_to_pcm_frame(decoder, sound.seekTo);
+            sound.decoderFinished = false;
+            sound.seekState = SeekState::Seeked;
+            return;
+        }
+        if (sound.seekState != SeekState::Idle)
+        {
+            return;
+        }
+
+        if (sound.decoderFinished)
+        {
+            if (!sound.repeat)
+            {
+                return;
+            }
+
+            ma_decoder_seek_to_pcm_frame(decoder, 0);
+            sound.decoderFinished = false;
+        }
+
+        bool rewound = false;
+        while (ma_pcm_rb_available_write(buffer) > 0)
+        {
+            auto frames = ma_pcm_rb_available_write(buffer);
+            void *destination{};
+
+            if (ma_pcm_rb_acquire_write(buffer, &frames, &destination) != MA_SUCCESS)
+            {
+                break;
+            }
+
+            ma_uint64 readFrames{};
+            ma_decoder_read_pcm_frames(decoder, destination, frames, &readFrames);
+            ma_pcm_rb_commit_write(buffer, static_cast<ma_uint32>(readFrames));
+
+            if (readFrames > 0)
+            {
+                rewound = false;
+            }
+
+            if (readFrames < frames)
+            {
+                //* Rewinding twice in a row without reading anything means there is nothing to read at all
+                if (sound.repeat && !rewound)
+                {
+                    ma_decoder_seek_to_pcm_frame(decoder, 0);
+                    rewound = true;
+                    continue;
+                }
+
+                sound.decoderFinished = true;
+                break;
+            }
+        }
+    }
+    void Audio::release(PlayingSound &sound)
+    {
+        if (auto *device = sound.raw.device.exchange(nullptr); device)
+        {
+            ma_device_uninit(device);
+        }
+        if (sound.playbackDevice.isNative)
+        {
+            //* Once we hold the lock the mixer is done with this sound and won't see it again
+            std::lock_guard lock(nativeMutex);
+            nativeVoices.erase(std::remove(nativeVoices.begin(), nativeVoices.end(), &sound), nativeVoices.end());
+        }
+
+        if (!sound.decoderMutex)
+        {
+            return;
+        }
+
+        std::lock_guard lock(*sound.decoderMutex);
+        if (auto *decoder = sound.raw.decoder.exchange(nullptr); decoder)
+        {
+            ma_decoder_uninit(decoder);
+            delete decoder;
+        }
+        if (auto *buffer = sound.raw.buffer.exchange(nullptr); buffer)
+        {
+            ma_pcm_rb_uninit(buffer);
+            delete buffer;
+        }
+    }
+    void Audio::logStats()
+    {
+        std::unique_lock lock(statsMutex);
+        while (!stopStatsLogger)
+        {
+            statsCv.wait_for(lock, std::chrono::seconds(10), [this] { return stopStatsLogger.load(); });
+            if (stopStatsLogger)
+            {
+                break;
+            }
+
+            for (const auto &stats : getDeviceStats())
+            {
+                if (stats.callbacks == 0)
+                {
+                    continue;
+                }
+
+                Fancy::fancy.logTime().message()
+                    << "[" << stats.device << "] callbacks: " << stats.callbacks << ", callback time (min/avg/max): "
+                    << stats.minCallbackTime << "/" << stats.averageCallbackTime << "/" << stats.maxCallbackTime
+                    << "us, frames (requested/delivered): " << stats.framesRequested << "/" << stats.framesDelivered
+                    << ", read stalls: " << stats.readStalls << std::endl;
+            }
+        }
+    }
+    std::shared_ptr<DeviceStats> Audio::getStatsFor(const std::string &device)
+    {
+        auto scoped = deviceStats.scoped();
+        if (scoped->find(device) == scoped->end())
+        {
+            scoped->emplace(device, std::make_shared<DeviceStats>());
+        }
+
+        return scoped->at(device);
+    }
+    std::vector<DeviceStatsSummary> Audio::getDeviceStats()
+    {
+        auto scoped = deviceStats.scoped();
+
+        std::vector<DeviceStatsSummary> rtn;
+        for (const auto &[device, stats] : *scoped)
+        {
+            DeviceStatsSummary summary;
+            summary.device = device;
+            summary.callbacks = stats->callbacks;
+            summary.readStalls = stats->readStalls;
+            summary.framesRequested = stats->framesRequested;
+            summary.framesDelivered = stats->framesDelivered;
+
+            if (summary.callbacks > 0)
+            {
+                summary.minCallbackTime = static_cast<double>(stats->callbackTimeMin) / 1000;
+                summary.maxCallbackTime = static_cast<double>(stats->callbackTimeMax) / 1000;
+                summary.averageCallbackTime =
+                    static_cast<double>(stats->callbackTimeTotal) / static_cast<double>(summary.callbacks) / 1000;
+            }
+
+            rtn.emplace_back(summary);
+        }
+
+        return rtn;
+    }
+    void DeviceStats::onCallback(std::uint64_t duration, std::uint64_t requested, std::uint64_t delivered)
+    {
+        callbacks++;
+        callbackTimeTotal += duration;
+        framesRequested += requested;
+        framesDelivered += delivered;
+
+        auto min = callbackTimeMin.load();
+        while (duration < min && !callbackTimeMin.compare_exchange_weak(min, duration))
+        {
+        }
+
+        auto max = callbackTimeMax.load();
+        while (duration > max && !callbackTimeMax.compare_exchange_weak(max, duration))
+        {
+        }
+    }
+    void Audio::tuneLatency()
+    {
+        cleanPlays = 0;
+        if (Globals::gSettings.latencyMode != Enums::LatencyMode::Auto)
+        {
+            return;
+        }
+
+#if defined(__linux__)
+        //* On PipeWire the graph quantum is the period everything runs at anyway, going below it gains us nothing
+        if (auto clock = Globals::gAudioBackend ? Globals::gAudioBackend->getGraphClock() : std::nullopt; clock)
+        {
+            auto quantum = static_cast<std::uint32_t>(
+                std::ceil(static_cast<double>(clock->quantum) / static_cast<double>(clock->rate) * 1000));
+
+            minPeriodSize = std::clamp<std::uint32_t>(quantum, 5, 100);
+            autoPeriodSize = minPeriodSize.load();
+
+            Fancy::fancy.logTime().message() << "Using period size of " << autoPeriodSize.load()
+                                             << "ms (graph quantum " << clock->quantum << "/" << clock->rate << ")"
+                                             << std::endl;
+            return;
+        }
+#endif
+
+        //* We ask the backend for the smallest period it is willing to give us, the period that is actually granted is
+        //* used as the lower bound for the auto mode. If we encounter underruns later on we will back off from there.
+        ma_device device;
+        auto config = ma_device_config_init(ma_device_type_playback);
+        config.periodSizeInMilliseconds = 5;
+        config.performanceProfile = ma_performance_profile_low_latency;
+
+        std::lock_guard lock(devicesMutex);
+        if (ma_device_init(getContext(), &config, &device) == MA_SUCCESS)
+        {
+            auto granted = static_cast<std::uint32_t>(
+                std::ceil(static_cast<double>(device.playback.internalPeriodSizeInFrames) /
+                          static_cast<double>(device.playback.internalSampleRate) * 1000));
+
+            minPeriodSize = std::clamp<std::uint32_t>(granted, 5, 100);
+            ma_device_uninit(&device);
+        }
+        else
+        {
+            Fancy::fancy.logTime().warning() << "Failed to probe period size, falling back to 20ms" << std::endl;
+            minPeriodSize = 20;
+        }
+
+        autoPeriodSize = minPeriodSize.load();
+        Fancy::fancy.logTime().message() << "Using period size of " << autoPeriodSize.load() << "ms" << std::endl;
+    }
+    std::uint32_t Audio::getPeriodSize() const
+    {
+        switch (Globals::gSettings.latencyMode)
+        {
+        case Enums::LatencyMode::Low:
+            return 20;
+        case Enums::LatencyMode::VeryLow:
+            return 10;
+        case Enums::LatencyMode::Lowest:
+            return 5;
+        case Enums::LatencyMode::Auto:
+            return autoPeriodSize;
+        default:
+            return 100;
+        }
+    }
+    void Audio::onUnderrun(PlayingSound *sound)
+    {
+        sound->underruns++;
+        sound->stats->readStalls++;
+
+        if (Globals::gSettings.latencyMode == Enums::LatencyMode::Auto)
+        {
+            auto current = autoPeriodSize.load();
+            if (sound->periodSize == current && current < 100)
+            {
+                //* Only the first underrun of a sound that was played with the current period size should back off,
+                //* otherwise a burst of underruns would immediately push us to the maximum.
+                if (autoPeriodSize.compare_exchange_strong(current, std::min<std::uint32_t>(current * 2, 100)))
+                {
+                    cleanPlays = 0;
+                    periodSizeIncreased = true;
+                }
+            }
+        }
     }
     std::optional<PlayingSound> Audio::play(const Objects::Sound &sound,
                                             const std::optional<Objects::AudioDevice> &playbackDevice)
     {
         static std::atomic<std::uint64_t> id = 0;
 
+        const auto &targetDevice = playbackDevice ? *playbackDevice : defaultPlayback;
+        if (Globals::gSettings.restartOnRetrigger)
+        {
+            if (auto retriggered = retrigger(sound, targetDevice.name); retriggered)
+            {
+                return retriggered;
+            }
+        }
+
+        //* Everything after the decoder works on floats, this way gain and peak don't have to care about the format.
+        //* Native devices are mixed by us, so the decoder has to convert to their format as well.
+        auto isNative = playbackDevice && playbackDevice->isNative;
         auto *decoder = new ma_decoder;
+        auto decoderConfig = isNative ? ma_decoder_config_init(ma_format_f32, playbackDevice->channels,
+                                                               playbackDevice->sampleRate)
+                                      : ma_decoder_config_init(ma_format_f32, 0, 0);
 #if defined(_WIN32)
-        auto res = ma_decoder_init_file_w(widen(sound.path).c_str(), nullptr, decoder);
+        auto res = ma_decoder_init_file_w(widen(sound.path).c_str(), &decoderConfig, decoder);
 #else
-        auto res = ma_decoder_init_file(sound.path.c_str(), nullptr, decoder);
+        auto res = ma_decoder_init_file(sound.path.c_str(), &decoderConfig, decoder);
 #endif
 
         if (res != MA_SUCCESS)
@@ -58,19 +455,44 @@ namespace Soundux::Objects
             return std::nullopt;
         }
 
-        auto *device = new ma_device;
-        auto config = ma_device_config_init(ma_device_type_playback);
+        auto periodSize = getPeriodSize();
+
+        //* The buffer has to hold at least a few periods, otherwise the decoder thread can't keep up with the callback
+        auto *buffer = new ma_pcm_rb;
+        auto bufferSize = static_cast<std::uint32_t>(
+            static_cast<std::uint64_t>(decoder->outputSampleRate) *
+            std::max<std::uint32_t>(Globals::gSettings.decodeAhead, periodSize * 4) / 1000);
+
+        if (ma_pcm_rb_init(decoder->outputFormat, decoder->outputChannels, bufferSize, nullptr, nullptr, buffer) !=
+            MA_SUCCESS)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to create decode buffer for file: " << sound.path << std::endl;
+            ma_decoder_uninit(decoder);
+            delete decoder;
+            delete buffer;
+
+            return std::nullopt;
+        }
 
         ma_uint64 length_in_pcm_frames{};
         ma_decoder_get_length_in_pcm_frames(decoder, &length_in_pcm_frames);
 
+        auto pSound = std::make_shared<PlayingSound>();
+
+        ma_device *device = nullptr;
+        auto config = ma_device_config_init(ma_device_type_playback);
+
         config.dataCallback = data_callback;
-        config.periodSizeInMilliseconds = 100;
+        config.periodSizeInMilliseconds = periodSize;
         config.sampleRate = decoder->outputSampleRate;
         config.playback.format = decoder->outputFormat;
         config.playback.channels = decoder->outputChannels;
 
-        auto pSound = std::make_shared<PlayingSound>();
+        if (periodSize < 100)
+        {
+            config.performanceProfile = ma_performance_profile_low_latency;
+        }
+
         config.pUserData = reinterpret_cast<void *>(static_cast<PlayingSound *>(pSound.get()));
 
         if (playbackDevice)
@@ -82,101 +504,278 @@ namespace Soundux::Objects
             config.playback.pDeviceID = &defaultPlayback.raw.id;
         }
 
-        if (ma_device_init(nullptr, &config, device) != MA_SUCCESS)
+        if (!isNative)
         {
-            Fancy::fancy.logTime().failure() << "Failed to create device" << std::endl;
-            ma_decoder_uninit(decoder);
-            delete decoder;
-            delete device;
+            device = new ma_device;
 
-            return std::nullopt;
+            std::unique_lock lock(devicesMutex);
+            auto result = ma_device_init(getContext(), &config, device);
+            lock.unlock();
+
+            if (result != MA_SUCCESS)
+            {
+                Fancy::fancy.logTime().failure() << "Failed to create device" << std::endl;
+                ma_pcm_rb_uninit(buffer);
+                ma_decoder_uninit(decoder);
+                delete buffer;
+                delete decoder;
+                delete device;
+
+                return std::nullopt;
+            }
         }
 
+        float volume = 1;
         if (playbackDevice)
         {
             if (sound.remoteVolume)
             {
-                device->masterVolumeFactor = static_cast<float>(*sound.remoteVolume) / 100.f;
+                volume = static_cast<float>(*sound.remoteVolume) / 100.f;
             }
             else
             {
-                device->masterVolumeFactor = static_cast<float>(Globals::gSettings.remoteVolume) / 100.f;
+                volume = static_cast<float>(Globals::gSettings.remoteVolume) / 100.f;
             }
         }
         else
         {
             if (sound.localVolume)
             {
-                device->masterVolumeFactor = static_cast<float>(*sound.localVolume) / 100.f;
+                volume = static_cast<float>(*sound.localVolume) / 100.f;
             }
             else
             {
-                device->masterVolumeFactor = static_cast<float>(Globals::gSettings.localVolume) / 100.f;
+                volume = static_cast<float>(Globals::gSettings.localVolume) / 100.f;
             }
         }
 
-        if (ma_device_start(device) != MA_SUCCESS)
+        if (device)
         {
-            ma_device_uninit(device);
-            ma_decoder_uninit(decoder);
-
-            delete device;
-            delete decoder;
-
-            Fancy::fancy.logTime().warning() << "Failed to play sound " << sound.path << std::endl;
-
-            return std::nullopt;
+            device->masterVolumeFactor = volume;
         }
+        pSound->volume = volume;
 
+        //* The callback may be invoked as soon as the device is started, so everything it uses has to be set up before
         auto soundId = ++id;
 
         pSound->id = soundId;
         pSound->sound = sound;
         pSound->raw.device = device;
         pSound->raw.decoder = decoder;
+        pSound->raw.buffer = buffer;
+        pSound->decoderMutex = std::make_shared<std::mutex>();
         pSound->length = length_in_pcm_frames;
-        pSound->sampleRate = config.sampleRate;
+        pSound->periodSize = periodSize;
+        pSound->sampleRate = decoder->outputSampleRate;
         pSound->playbackDevice = playbackDevice ? *playbackDevice : defaultPlayback;
+        pSound->stats = getStatsFor(pSound->playbackDevice.name);
+
+        if (Globals::gSettings.normalizeLoudness)
+        {
+            pSound->gain = Globals::gLoudness.getGain(sound).value_or(1.f);
+        }
         pSound->lengthInMs = static_cast<std::uint64_t>(static_cast<double>(pSound->length) /
-                                                        static_cast<double>(config.sampleRate) * 1000);
+                                                        static_cast<double>(pSound->sampleRate) * 1000);
+
+        //* Prime the buffer so that the first callback doesn't come up empty, the decoder thread takes it from here
+        decodeAhead(*pSound);
+
+        {
+            auto scoped = playingSounds.scoped();
+            scoped->emplace(soundId, pSound);
+            voiceIndex[sound.id][pSound->playbackDevice.name] = soundId;
+
+            //* Voices are stolen before the new one starts, so the limit is never exceeded
+            if (Globals::gSettings.maxVoices > 0)
+            {
+                enforceVoiceLimit(pSound->playbackDevice.name, soundId);
+            }
+
+            if (isNative)
+            {
+                std::lock_guard lock(nativeMutex);
+                nativeVoices.emplace_back(pSound.get());
+            }
+            else if (ma_device_start(device) != MA_SUCCESS)
+            {
+                forget(*pSound);
+                release(*pSound);
+                delete device;
+
+                Fancy::fancy.logTime().warning() << "Failed to play sound " << sound.path << std::endl;
+
+                return std::nullopt;
+            }
+        }
+        notifyDecoder();
 
-        playingSounds->emplace(soundId, pSound);
         return *pSound;
     }
-    void Audio::stopAll()
+    void Audio::link(std::uint32_t first, std::uint32_t second)
     {
         auto scoped = playingSounds.scoped();
-        while (!scoped->empty())
+        if (scoped->count(first) && scoped->count(second))
         {
-            auto &sound = scoped->begin()->second;
-            if (sound->raw.device && sound->raw.decoder)
+            partners[first] = second;
+            partners[second] = first;
+        }
+    }
+    std::optional<PlayingSound> Audio::retrigger(const Objects::Sound &sound, const std::string &device)
+    {
+        auto scoped = playingSounds.scoped();
+
+        auto voices = voiceIndex.find(sound.id);
+        if (voices == voiceIndex.end())
+        {
+            return std::nullopt;
+        }
+
+        auto voice = voices->second.find(device);
+        if (voice == voices->second.end())
+        {
+            return std::nullopt;
+        }
+
+        auto &playing = scoped->at(voice->second);
+        auto *buffer = playing->raw.buffer.load();
+
+        if (!buffer || playing->finished)
+        {
+            //* The sound already finished and is only waiting to be reported, so we can't reuse it
+            return std::nullopt;
+        }
+
+        playing->seekTo = 0;
+        playing->shouldSeek = true;
+
+        //* The callback won't finish the sound once it sees the seek. If it finished it before that, a new voice has
+        //* to be started instead.
+        if (playing->finished)
+        {
+            playing->shouldSeek = false;
+            return std::nullopt;
+        }
+
+        notifyDecoder();
+
+        if (playing->paused)
+        {
+            resume(playing->id);
+        }
+
+        auto rtn = *playing;
+        rtn.readFrames = 0;
+        rtn.readInMs = 0;
+        rtn.retriggered = true;
+
+        return rtn;
+    }
+    void Audio::enforceVoiceLimit(const std::string &device, std::uint32_t newest)
+    {
+        auto scoped = playingSounds.scoped();
+
+        std::vector<std::shared_ptr<PlayingSound>> voices;
+        for (const auto &[id, sound] : *scoped)
+        {
+            if (id != newest && sound->playbackDevice.name == device)
             {
-                ma_device_uninit(sound->raw.device);
-                ma_decoder_uninit(sound->raw.decoder);
+                voices.emplace_back(sound);
             }
+        }
 
-            sound->raw.device = nullptr;
-            sound->raw.decoder = nullptr;
+        while (!voices.empty() && voices.size() + 1 > Globals::gSettings.maxVoices)
+        {
+            //* The map is ordered by id, so the first voice is always the oldest one
+            auto victim = voices.begin();
+            if (Globals::gSettings.stealingPolicy == Enums::StealingPolicy::Quietest)
+            {
+                auto loudness = [](const std::shared_ptr<PlayingSound> &sound) {
+                    auto *device = sound->raw.device.load();
+                    auto volume = device ? device->masterVolumeFactor : sound->volume.load();
+
+                    return sound->paused ? 0.f : sound->peak * volume;
+                };
+
+                victim = std::min_element(voices.begin(), voices.end(),
+                                          [&](const auto &a, const auto &b) { return loudness(a) < loudness(b); });
+            }
 
-            scoped->erase(sound->id);
+            //* Stopping only one half of a local and remote pair would leave the other one playing on its own
+            std::vector<std::shared_ptr<PlayingSound>> stolen{*victim};
+            if (auto partner = partners.find((*victim)->id); partner != partners.end())
+            {
+                if (auto sound = scoped->find(partner->second); sound != scoped->end())
+                {
+                    stolen.emplace_back(sound->second);
+                }
+            }
+
+            for (const auto &sound : stolen)
+            {
+                auto copy = *sound;
+                release(*sound);
+
+                copy.raw.device = nullptr;
+                copy.raw.decoder = nullptr;
+                copy.raw.buffer = nullptr;
+
+                Fancy::fancy.logTime().message()
+                    << "Voice limit reached on " << device << ", stopping sound " << copy.id << std::endl;
+
+                //* The newest sound is already registered, so this will not be mistaken for the last sound finishing
+                Globals::gGui->onSoundFinished(copy);
+
+                forget(*sound);
+                voices.erase(std::remove(voices.begin(), voices.end(), sound), voices.end());
+            }
         }
     }
-    bool Audio::stop(const std::uint32_t &soundId)
+    void Audio::forget(const PlayingSound &sound)
     {
         auto scoped = playingSounds.scoped();
-        if (scoped->find(soundId) != scoped->end())
+
+        auto voices = voiceIndex.find(sound.sound.id);
+        if (voices != voiceIndex.end())
         {
-            auto &sound = scoped->at(soundId);
-            if (sound->raw.device && sound->raw.decoder)
+            auto voice = voices->second.find(sound.playbackDevice.name);
+            if (voice != voices->second.end() && voice->second == sound.id)
             {
-                ma_device_uninit(sound->raw.device);
-                ma_decoder_uninit(sound->raw.decoder);
+                voices->second.erase(voice);
             }
+            if (voices->second.empty())
+            {
+                voiceIndex.erase(voices);
+            }
+        }
+
+        if (auto partner = partners.find(sound.id); partner != partners.end())
+        {
+            partners.erase(partner->second);
+            partners.erase(partner);
+        }
+
+        scoped->erase(sound.id);
+    }
+    void Audio::stopAll()
+    {
+        auto scoped = playingSounds.scoped();
+        while (!scoped->empty())
+        {
+            auto &sound = scoped->begin()->second;
+            release(*sound);
 
-            sound->raw.device = nullptr;
-            sound->raw.decoder = nullptr;
+            forget(*sound);
+        }
+    }
+    bool Audio::stop(const std::uint32_t &soundId)
+    {
+        auto scoped = playingSounds.scoped();
+        if (scoped->find(soundId) != scoped->end())
+        {
+            auto &sound = scoped->at(soundId);
+            release(*sound);
 
-            scoped->erase(sound->id);
+            forget(*sound);
             return true;
         }
 
@@ -193,7 +792,8 @@ namespace Soundux::Objects
 
             if (!sound->paused)
             {
-                if (ma_device_get_state(sound->raw.device) == ma_device_state_started)
+                //* Native sounds are simply skipped by the mixer while paused
+                if (sound->raw.device && ma_device_get_state(sound->raw.device) == ma_device_state_started)
                 {
                     ma_device_stop(sound->raw.device);
                 }
@@ -231,7 +831,8 @@ namespace Soundux::Objects
 
             if (sound->paused)
             {
-                if (ma_device_get_state(sound->raw.device) == ma_device_state_stopped)
+                //* Native sounds are simply picked up by the mixer again
+                if (sound->raw.device && ma_device_get_state(sound->raw.device) == ma_device_state_stopped)
                 {
                     ma_device_start(sound->raw.device);
                 }
@@ -247,17 +848,33 @@ namespace Soundux::Objects
     }
     void Audio::onFinished(PlayingSound sound)
     {
+        if (Globals::gSettings.latencyMode == Enums::LatencyMode::Auto && sound.underruns == 0)
+        {
+            auto current = autoPeriodSize.load();
+            if (sound.periodSize == current && current > minPeriodSize && ++cleanPlays >= 16)
+            {
+                //* Try to step down again after a few sounds played without any underruns
+                auto decreased = std::max<std::uint32_t>(current / 2, minPeriodSize);
+                if (autoPeriodSize.compare_exchange_strong(current, decreased))
+                {
+                    Fancy::fancy.logTime().message()
+                        << "Decreasing period size to " << autoPeriodSize.load() << "ms" << std::endl;
+                }
+                cleanPlays = 0;
+            }
+        }
+
         auto scoped = playingSounds.scoped();
         if (scoped->find(sound.id) != scoped->end())
         {
-            ma_device_uninit(sound.raw.device);
-            ma_decoder_uninit(sound.raw.decoder);
+            release(*scoped->at(sound.id));
 
             sound.raw.device = nullptr;
             sound.raw.decoder = nullptr;
+            sound.raw.buffer = nullptr;
 
             Globals::gGui->onSoundFinished(sound);
-            scoped->erase(sound.id);
+            forget(sound);
         }
         else
         {
@@ -266,18 +883,37 @@ namespace Soundux::Objects
     }
     void Audio::onSoundProgressed(PlayingSound *sound, std::uint64_t frames)
     {
-        sound->readFrames += frames;
-        sound->buffer += frames;
+        auto readFrames = sound->readFrames + frames;
+        if (sound->repeat && sound->length > 0)
+        {
+            //* The decoder thread rewinds on its own, so we have to wrap around here
+            readFrames %= sound->length;
+        }
 
-        if (sound->buffer > (sound->sampleRate / 2))
+        sound->readFrames = readFrames;
+        sound->buffer += frames;
+    }
+    void Audio::report(PlayingSound &sound)
+    {
+        if (sound.finished && !sound.finishReported)
         {
-            sound->readInMs = static_cast<std::uint64_t>(
-                (static_cast<double>(sound->readFrames) / static_cast<double>(sound->length)) *
-                static_cast<double>(sound->lengthInMs));
+            sound.finishReported = true;
+            Globals::gQueue.push_unique(reinterpret_cast<std::uintptr_t>(&sound),
+                                        [sound = sound] { Globals::gAudio.onFinished(sound); });
+            return;
+        }
 
-            Globals::gGui->onSoundProgressed(*sound);
+        if (sound.buffer > (sound.sampleRate / 2))
+        {
+            sound.buffer = 0;
+            sound.readInMs = static_cast<std::uint64_t>(
+                (static_cast<double>(sound.readFrames) / static_cast<double>(sound.length)) *
+                static_cast<double>(sound.lengthInMs));
 
-            sound->buffer = 0;
+            if (Globals::gGui)
+            {
+                Globals::gGui->onSoundProgressed(sound);
+            }
         }
     }
     void Audio::onSoundSeeked(PlayingSound *sound, std::uint64_t frame)
@@ -297,9 +933,10 @@ namespace Soundux::Objects
                 static_cast<std::uint64_t>((static_cast<double>(position) / static_cast<double>(sound->lengthInMs)) *
                                            static_cast<double>(sound->length));
             sound->shouldSeek = true;
+            notifyDecoder();
 
             auto rtn = *sound;
-            rtn.readFrames = rtn.seekTo;
+            rtn.readFrames = rtn.seekTo.load();
             rtn.readInMs =
                 static_cast<std::uint64_t>((static_cast<double>(rtn.seekTo) / static_cast<double>(rtn.length)) *
                                            static_cast<double>(rtn.lengthInMs));
@@ -320,57 +957,187 @@ namespace Soundux::Objects
             return;
         }
 
-        if (!sound->raw.decoder)
+        pull(sound, static_cast<float *>(output), frameCount, device->playback.channels);
+    }
+    void Audio::mix(float *output, std::uint32_t frameCount, std::uint32_t channels)
+    {
+        auto samples = static_cast<std::uint64_t>(frameCount) * channels;
+        std::fill(output, output + samples, 0.f);
+
+        //* Called from the realtime thread of the backend, if a sound is just being added or removed we rather skip a
+        //* period than wait
+        std::unique_lock lock(nativeMutex, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
+        }
+
+        auto chunkSize = channels > 0 ? static_cast<std::uint32_t>(mixBuffer.size() / channels) : 0;
+        if (chunkSize == 0)
         {
             return;
         }
 
-        ma_uint64 readFrames{};
-        ma_decoder_read_pcm_frames(sound->raw.decoder, output, frameCount, &readFrames);
+        for (auto *sound : nativeVoices)
+        {
+            if (sound->paused)
+            {
+                continue;
+            }
+
+            auto volume = sound->volume.load();
+            for (std::uint32_t offset = 0; frameCount > offset;)
+            {
+                auto frames = std::min(chunkSize, frameCount - offset);
+                auto read = pull(sound, mixBuffer.data(), frames, channels);
+
+                auto *target = output + static_cast<std::uint64_t>(offset) * channels;
+                for (std::uint64_t i = 0; read * channels > i; i++)
+                {
+                    target[i] += mixBuffer[i] * volume;
+                }
+
+                if (read < frames)
+                {
+                    break;
+                }
+                offset += frames;
+            }
+        }
+    }
+    void Audio::prepareMix(std::uint32_t frameCount, std::uint32_t channels)
+    {
+        std::lock_guard lock(nativeMutex);
+        mixBuffer.assign(static_cast<std::size_t>(frameCount) * channels, 0.f);
+    }
+    std::uint64_t Audio::pull(PlayingSound *sound, float *output, std::uint32_t frameCount, std::uint32_t channels)
+    {
+        auto *buffer = sound->raw.buffer.load();
+        if (!buffer)
+        {
+            return 0;
+        }
+
+        auto now = std::chrono::steady_clock::now();
 
+        //* The decoder is owned by the decoder thread, all we do here is copy what it already decoded for us.
+        //* Seeking is a handshake: we request it, the decoder thread seeks and stops writing, then we flush.
         if (sound->shouldSeek)
         {
-            ma_decoder_seek_to_pcm_frame(sound->raw.decoder, sound->seekTo);
+            sound->shouldSeek = false;
+            sound->seekState = SeekState::Requested;
+        }
+        if (sound->seekState == SeekState::Seeked)
+        {
+            ma_pcm_rb_reset(buffer);
             Globals::gAudio.onSoundSeeked(sound, sound->seekTo);
+            sound->seekState = SeekState::Idle;
         }
+
+        ma_uint64 readFrames{};
+        if (sound->seekState == SeekState::Idle)
+        {
+            auto frameSize = ma_get_bytes_per_frame(ma_format_f32, channels);
+            while (readFrames < frameCount)
+            {
+                auto frames = static_cast<ma_uint32>(frameCount - readFrames);
+                void *source{};
+
+                if (ma_pcm_rb_acquire_read(buffer, &frames, &source) != MA_SUCCESS || frames == 0)
+                {
+                    break;
+                }
+
+                std::memcpy(reinterpret_cast<std::uint8_t *>(output) + readFrames * frameSize, source,
+                            frames * frameSize);
+                ma_pcm_rb_commit_read(buffer, frames);
+                readFrames += frames;
+            }
+
+            auto sampleCount = readFrames * channels;
+
+            if (auto gain = sound->gain.load(); gain != 1.f)
+            {
+                for (std::uint64_t i = 0; sampleCount > i; i++)
+                {
+                    output[i] *= gain;
+                }
+            }
+
+            sound->peak = std::max(getPeak(output, sampleCount), sound->peak * 0.9f);
+
+            if (readFrames < frameCount && !sound->decoderFinished)
+            {
+                //* The decoder thread fell behind, the rest of this period stays silent. This is what is audible as an
+                //* underrun, unlike late callbacks which the device covers with what it still had buffered.
+                Globals::gAudio.onUnderrun(sound);
+            }
+        }
+
         if (sound->playbackDevice.isDefault && readFrames > 0)
         {
             Globals::gAudio.onSoundProgressed(sound, readFrames);
         }
 
-        if (readFrames <= 0)
+        //* While a seek is in flight the buffer is empty on purpose and the decoder has not rewound yet, so the sound
+        //* must not be mistaken for finished
+        auto seeking = sound->shouldSeek || sound->seekState != SeekState::Idle;
+        if (readFrames <= 0 && sound->decoderFinished && !sound->repeat && !seeking)
         {
-            if (sound->repeat)
-            {
-                ma_decoder_seek_to_pcm_frame(sound->raw.decoder, 0);
-                Globals::gAudio.onSoundSeeked(sound, 0);
-            }
-            else
+            sound->finished = true;
+        }
+
+        auto callbackTime = std::chrono::steady_clock::now() - now;
+        sound->stats->onCallback(std::chrono::duration_cast<std::chrono::nanoseconds>(callbackTime).count(), frameCount,
+                                 readFrames);
+
+        return readFrames;
+    }
+    void Audio::setVolume(const std::uint32_t &soundId, float volume)
+    {
+        auto scoped = playingSounds.scoped();
+        if (scoped->find(soundId) != scoped->end())
+        {
+            auto &sound = scoped->at(soundId);
+            if (auto *device = sound->raw.device.load(); device)
             {
-                Globals::gQueue.push_unique(reinterpret_cast<std::uintptr_t>(device),
-                                            [sound = *sound] { Globals::gAudio.onFinished(sound); });
+                device->masterVolumeFactor = volume;
             }
+            sound->volume = volume;
         }
     }
-    std::vector<AudioDevice> Audio::getAudioDevices()
+    float Audio::getPeak(const float *data, std::uint64_t samples)
     {
-        std::string defaultName;
+        float peak = 0;
+        for (std::uint64_t i = 0; samples > i; i++)
         {
-            ma_device device;
-            ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-            ma_device_init(nullptr, &deviceConfig, &device);
+            peak = std::max(peak, std::abs(data[i]));
+        }
 
-            defaultName = device.playback.name;
+        return peak;
+    }
+    void Audio::refreshDevices()
+    {
+        TraceScope scope("Audio::refreshDevices");
 
-            ma_device_uninit(&device);
-        }
+        devices.clear();
+        deviceIndex.clear();
 
-        ma_context context;
+        if (!getContext())
+        {
+            devicesChanged = true;
+            return;
+        }
 
-        if (ma_context_init(nullptr, 0, nullptr, &context) != MA_SUCCESS)
+        std::string defaultName;
         {
-            Fancy::fancy.logTime().failure() << "Failed to initialize context" << std::endl;
-            return {};
+            ma_device device;
+            ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+            if (ma_device_init(&context, &deviceConfig, &device) == MA_SUCCESS)
+            {
+                defaultName = device.playback.name;
+                ma_device_uninit(&device);
+            }
         }
 
         ma_device_info *pPlayBackDeviceInfos{};
@@ -380,10 +1147,10 @@ namespace Soundux::Objects
         if (result != MA_SUCCESS)
         {
             Fancy::fancy.logTime().failure() << "Failed to get playback devices!" << std::endl;
-            return {};
+            devicesChanged = true;
+            return;
         }
 
-        std::vector<AudioDevice> playBackDevices;
         for (unsigned int i = 0; deviceCount > i; i++)
         {
             auto &rawDevice = pPlayBackDeviceInfos[i];
@@ -393,34 +1160,75 @@ namespace Soundux::Objects
             device.name = rawDevice.name;
             device.isDefault = rawDevice.name == defaultName;
 
-            playBackDevices.emplace_back(device);
+            devices.emplace_back(device);
         }
 
-        ma_context_uninit(&context);
-
-        for (auto it = playBackDevices.begin(); it != playBackDevices.end(); it++)
+        for (auto it = devices.begin(); it != devices.end(); it++)
         {
             if (it->name.find("VB-Audio") != std::string::npos)
             {
-                if (it != playBackDevices.begin())
+                if (it != devices.begin())
                 {
-                    std::iter_swap(playBackDevices.begin(), it);
+                    std::iter_swap(devices.begin(), it);
                 }
             }
         }
 
-        return playBackDevices;
+        for (std::size_t i = 0; devices.size() > i; i++)
+        {
+            deviceIndex.emplace(devices[i].name, i);
+        }
     }
-#if defined(_WIN32)
-    std::optional<AudioDevice> Audio::getAudioDevice(const std::string &name)
+    ma_context *Audio::getContext()
     {
-        for (const auto &device : getAudioDevices())
+        if (!hasContext)
         {
-            if (device.name == name)
+            if (ma_context_init(nullptr, 0, nullptr, &context) != MA_SUCCESS)
             {
-                return device;
+                Fancy::fancy.logTime().failure() << "Failed to initialize context" << std::endl;
+                return nullptr;
             }
+            hasContext = true;
+        }
+
+        return &context;
+    }
+    void Audio::invalidateDevices()
+    {
+        devicesChanged = true;
+    }
+    std::vector<AudioDevice> Audio::getAudioDevices()
+    {
+        std::lock_guard lock(devicesMutex);
+        if (devicesChanged.exchange(false))
+        {
+            refreshDevices();
         }
+
+        return devices;
+    }
+#if defined(_WIN32)
+    std::optional<AudioDevice> Audio::getAudioDevice(const std::string &name)
+    {
+        std::lock_guard lock(devicesMutex);
+        if (devicesChanged.exchange(false))
+        {
+            refreshDevices();
+        }
+
+        auto device = deviceIndex.find(name);
+        if (device == deviceIndex.end())
+        {
+            //* We don't get hotplug notifications on windows, so the device might just have been plugged in
+            refreshDevices();
+            device = deviceIndex.find(name);
+        }
+
+        if (device != deviceIndex.end())
+        {
+            return devices[device->second];
+        }
+
         return std::nullopt;
     }
 #endif
@@ -445,22 +1253,35 @@ namespace Soundux::Objects
 
         length = other.length;
         lengthInMs = other.lengthInMs;
-        readFrames = other.readFrames;
         sampleRate = other.sampleRate;
 
         id = other.id;
         sound = other.sound;
-        buffer = other.buffer;
+        periodSize = other.periodSize;
+        finishReported = other.finishReported;
+        retriggered = other.retriggered;
 
         seekTo.store(other.seekTo);
         paused.store(other.paused);
         repeat.store(other.repeat);
         readInMs.store(other.readInMs);
+        underruns.store(other.underruns);
+        peak.store(other.peak);
+        gain.store(other.gain);
+        volume.store(other.volume);
         shouldSeek.store(other.shouldSeek);
+        seekState.store(other.seekState);
+        decoderFinished.store(other.decoderFinished);
+        readFrames.store(other.readFrames);
+        buffer.store(other.buffer);
+        finished.store(other.finished);
 
         raw.device.store(other.raw.device);
         raw.decoder.store(other.raw.decoder);
+        raw.buffer.store(other.raw.buffer);
         playbackDevice = other.playbackDevice;
+        stats = other.stats;
+        decoderMutex = other.decoderMutex;
     }
     PlayingSound &PlayingSound::operator=(const PlayingSound &other)
     {
@@ -471,22 +1292,35 @@ namespace Soundux::Objects
 
         length = other.length;
         lengthInMs = other.lengthInMs;
-        readFrames = other.readFrames;
         sampleRate = other.sampleRate;
 
         id = other.id;
         sound = other.sound;
-        buffer = other.buffer;
+        periodSize = other.periodSize;
+        finishReported = other.finishReported;
+        retriggered = other.retriggered;
 
         seekTo.store(other.seekTo);
         paused.store(other.paused);
         repeat.store(other.repeat);
         readInMs.store(other.readInMs);
+        underruns.store(other.underruns);
+        peak.store(other.peak);
+        gain.store(other.gain);
+        volume.store(other.volume);
         shouldSeek.store(other.shouldSeek);
+        seekState.store(other.seekState);
+        decoderFinished.store(other.decoderFinished);
+        readFrames.store(other.readFrames);
+        buffer.store(other.buffer);
+        finished.store(other.finished);
 
         raw.device.store(other.raw.device);
         raw.decoder.store(other.raw.decoder);
+        raw.buffer.store(other.raw.buffer);
         playbackDevice = other.playbackDevice;
+        stats = other.stats;
+        decoderMutex = other.decoderMutex;
 
         return *this;
     }
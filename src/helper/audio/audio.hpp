@@ -1,14 +1,20 @@
 #pragma once
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <core/objects/objects.hpp>
 #include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
 #include <miniaudio.h>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <var_guard.hpp>
+#include <vector>
 
 namespace Soundux
 {
@@ -19,20 +25,69 @@ namespace Soundux
             ma_device_info raw;
             std::string name;
             bool isDefault;
+
+            //* Native devices are fed by the audio backend through `Audio::mix`, `raw` is unused for them
+            bool isNative = false;
+            std::uint32_t sampleRate = 0;
+            std::uint32_t channels = 0;
+        };
+        struct DeviceStats
+        {
+            //* Durations are stored in nanoseconds
+            std::atomic<std::uint64_t> callbacks = 0;
+            std::atomic<std::uint64_t> callbackTimeTotal = 0;
+            std::atomic<std::uint64_t> callbackTimeMin = std::numeric_limits<std::uint64_t>::max();
+            std::atomic<std::uint64_t> callbackTimeMax = 0;
+
+            std::atomic<std::uint64_t> framesRequested = 0;
+            std::atomic<std::uint64_t> framesDelivered = 0;
+
+            //* Periods that could not be filled because the decoder thread fell behind, which we count as underruns
+            std::atomic<std::uint64_t> readStalls = 0;
+
+            void onCallback(std::uint64_t, std::uint64_t, std::uint64_t);
+        };
+        struct DeviceStatsSummary
+        {
+            std::string device;
+            std::uint64_t callbacks = 0;
+
+            //* In microseconds
+            double minCallbackTime = 0;
+            double maxCallbackTime = 0;
+            double averageCallbackTime = 0;
+
+            std::uint64_t framesRequested = 0;
+            std::uint64_t framesDelivered = 0;
+
+            std::uint64_t readStalls = 0;
+        };
+        enum class SeekState : std::uint8_t
+        {
+            Idle,
+            Requested, //* Set by the callback, the decoder thread will seek and stop writing
+            Seeked,    //* Set by the decoder thread, the callback may now flush the buffer
         };
         struct PlayingSound
         {
             AudioDevice playbackDevice;
+            std::shared_ptr<DeviceStats> stats;
 
             struct
             {
                 std::atomic<ma_device *> device;
                 std::atomic<ma_decoder *> decoder;
+                std::atomic<ma_pcm_rb *> buffer;
             } raw;
 
+            //* Guards the decoder, which is only ever used by the decoder thread once the sound is playing
+            std::shared_ptr<std::mutex> decoderMutex;
+            std::atomic<bool> decoderFinished = false;
+            std::atomic<SeekState> seekState = SeekState::Idle;
+
             std::uint64_t length = 0;
             std::uint64_t lengthInMs = 0;
-            std::uint64_t readFrames = 0;
+            std::atomic<std::uint64_t> readFrames = 0;
             std::uint64_t sampleRate = 0;
 
             std::atomic<bool> paused = false;
@@ -41,9 +96,21 @@ namespace Soundux
             std::atomic<std::uint64_t> seekTo = 0;
             std::atomic<std::uint64_t> readInMs = 0;
 
+            std::uint32_t periodSize = 0;
+            std::atomic<std::uint32_t> underruns = 0;
+            std::atomic<float> peak = 0; //* Decaying peak of the decoded signal, used for voice stealing
+            std::atomic<float> gain = 1; //* Loudness normalization, applied on top of the volume
+            std::atomic<float> volume = 1; //* Only used on native devices, others use the master volume of the device
+            //* Set by the callback once everything was played, the decoder thread reports it from there
+            std::atomic<bool> finished = false;
+            bool finishReported = false;
+            //* Set when `play` restarted a voice that was already playing instead of starting a new one, the ui should
+            //* update its existing entry
+            bool retriggered = false;
+
             Sound sound;
             std::uint32_t id;
-            std::uint64_t buffer = 0;
+            std::atomic<std::uint64_t> buffer = 0; //* Frames played since the progress was last reported
 
             PlayingSound() = default;
             PlayingSound(const PlayingSound &);
@@ -53,10 +120,71 @@ namespace Soundux
         {
             sxl::var_guard<std::map<std::uint32_t, std::shared_ptr<PlayingSound>>, std::recursive_mutex> playingSounds;
 
+            //* Sound id -> playback device -> latest playing sound id, guarded by the lock of `playingSounds`
+            std::unordered_map<std::uint32_t, std::unordered_map<std::string, std::uint32_t>> voiceIndex;
+            //* Voices that belong together (i.e. local and remote playback of a sound) are stolen together, guarded by
+            //* the lock of `playingSounds`
+            std::unordered_map<std::uint32_t, std::uint32_t> partners;
+
+            void forget(const PlayingSound &);
+            void enforceVoiceLimit(const std::string &, std::uint32_t);
+            std::optional<PlayingSound> retrigger(const Objects::Sound &, const std::string &);
+            static float getPeak(const float *, std::uint64_t);
+
+            //* Only used when the latency mode is set to auto
+            std::atomic<std::uint32_t> cleanPlays = 0;
+            std::atomic<std::uint32_t> minPeriodSize = 5;
+            std::atomic<std::uint32_t> autoPeriodSize = 100;
+
+            sxl::var_guard<std::map<std::string, std::shared_ptr<DeviceStats>>> deviceStats;
+
+            std::mutex statsMutex;
+            std::thread statsLogger;
+            std::condition_variable statsCv;
+            std::atomic<bool> stopStatsLogger = false;
+
+            std::mutex decodeMutex;
+            std::thread decodeThread;
+            std::condition_variable decodeCv;
+            std::atomic<bool> stopDecoder = false;
+            bool decodePending = false;
+
+            void decodeLoop();
+            void notifyDecoder();
+            static void decodeAhead(PlayingSound &);
+            void release(PlayingSound &);
+
+            //* Sounds played on a native device, the backend pulls them through `mix`
+            std::mutex nativeMutex;
+            std::vector<PlayingSound *> nativeVoices;
+            std::vector<float> mixBuffer;
+
+            //* The callbacks run on realtime threads, so they only leave flags behind which the decoder thread turns
+            //* into log messages and ui notifications
+            std::atomic<bool> periodSizeIncreased = false;
+            void report(PlayingSound &);
+
+            void logStats();
+            std::shared_ptr<DeviceStats> getStatsFor(const std::string &);
+
+            //* The context lives as long as we do, devices are only enumerated again once the backend reported a change
+            ma_context context;
+            bool hasContext = false;
+            std::mutex devicesMutex;
+            std::vector<AudioDevice> devices;
+            std::unordered_map<std::string, std::size_t> deviceIndex;
+            std::atomic<bool> devicesChanged = true;
+
+            void refreshDevices();
+            //* Lazily creates the context, requires `devicesMutex` to be held
+            ma_context *getContext();
+
+            void onUnderrun(PlayingSound *);
             void onFinished(PlayingSound);
             void onSoundSeeked(PlayingSound *, std::uint64_t);
             void onSoundProgressed(PlayingSound *, std::uint64_t);
 
+            static std::uint64_t pull(PlayingSound *, float *, std::uint32_t, std::uint32_t);
             static void data_callback(ma_device *device, void *output, const void *input, std::uint32_t frameCount);
 
           public:
@@ -65,8 +193,17 @@ namespace Soundux
             std::optional<PlayingSound> repeat(const std::uint32_t &, bool);
             std::optional<PlayingSound> seek(const std::uint32_t &, std::uint64_t);
             std::optional<PlayingSound> play(const Objects::Sound &, const std::optional<AudioDevice> & = std::nullopt);
+            void link(std::uint32_t, std::uint32_t);
+
+            //* Allocates what `mix` needs for the given period, larger periods are mixed in several passes
+            void prepareMix(std::uint32_t, std::uint32_t);
+            void mix(float *, std::uint32_t, std::uint32_t);
+            void setVolume(const std::uint32_t &, float);
 
             std::vector<AudioDevice> getAudioDevices();
+            //* Called by the audio backends when a device was added, removed or the default device changed
+            void invalidateDevices();
+            std::vector<DeviceStatsSummary> getDeviceStats();
             std::vector<Objects::PlayingSound> getPlayingSounds();
 
 #if defined(_WIN32)
@@ -76,6 +213,9 @@ namespace Soundux
             void setup();
             void destroy();
 
+            void tuneLatency();
+            std::uint32_t getPeriodSize() const;
+
             void stopAll();
             bool stop(const std::uint32_t &);
 
@@ -9,8 +9,10 @@
 
 namespace Soundux::Objects
 {
-    std::shared_ptr<AudioBackend> AudioBackend::createInstance(Enums::BackendType backend)
+    std::shared_ptr<AudioBackend> AudioBackend::createInstance(Enums::BackendType &backend)
     {
+        TraceScope scope("AudioBackend::createInstance");
+
         std::shared_ptr<AudioBackend> instance;
         if (backend == Enums::BackendType::PulseAudio)
         {
@@ -19,7 +21,7 @@ namespace Soundux::Objects
 
             if (pulseInstance && pulseInstance->setup())
             {
-                if (!pulseInstance->switchOnConnectPresent())
+                if (!pulseInstance->isSwitchOnConnectLoaded())
                 {
                     if (pulseInstance->loadModules())
                     {
@@ -35,7 +37,6 @@ namespace Soundux::Objects
             if (pulseInstance && pulseInstance->isRunningPipeWire())
             {
                 backend = Enums::BackendType::PipeWire;
-                Globals::gSettings.audioBackend = backend;
             }
         }
 
@@ -49,8 +50,38 @@ namespace Soundux::Objects
         }
 
         Fancy::fancy.logTime().failure() << "Failed to create AudioBackend instance" << std::endl;
-        Globals::gSettings.audioBackend = Enums::BackendType::None;
+        backend = Enums::BackendType::None;
         return nullptr;
     }
+    bool AudioBackend::startMuteSession()
+    {
+        std::lock_guard lock(muteMutex);
+        if (muted)
+        {
+            return true;
+        }
+
+        muted = muteInput(true);
+        return muted;
+    }
+    bool AudioBackend::endMuteSession()
+    {
+        std::lock_guard lock(muteMutex);
+        if (!muted)
+        {
+            return true;
+        }
+
+        muted = !muteInput(false);
+        return !muted;
+    }
+    std::optional<NativeOutput> AudioBackend::getNativeOutput()
+    {
+        return std::nullopt;
+    }
+    std::optional<GraphClock> AudioBackend::getGraphClock()
+    {
+        return std::nullopt;
+    }
 } // namespace Soundux::Objects
 #endif
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 #if defined(__linux__)
 #include <core/enums/enums.hpp>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
@@ -25,14 +28,32 @@ namespace Soundux
             virtual ~PlaybackApp() = default;
         };
 
+        struct NativeOutput
+        {
+            std::uint32_t sampleRate;
+            std::uint32_t channels;
+        };
+
+        struct GraphClock
+        {
+            std::uint32_t rate;
+            std::uint32_t quantum; //* In frames
+        };
+
         class AudioBackend
         {
+            std::mutex muteMutex;
+            bool muted = false;
+
           protected:
             virtual bool setup() = 0;
             AudioBackend() = default;
 
           public:
-            static std::shared_ptr<AudioBackend> createInstance(Enums::BackendType);
+            virtual ~AudioBackend() = default;
+            //* Falls back to PipeWire if PulseAudio is served by it, the backend that ended up being used is written
+            //* back. Does not notify the ui, so that it can run before the ui exists.
+            static std::shared_ptr<AudioBackend> createInstance(Enums::BackendType &);
 
           public:
             virtual void destroy() = 0;
@@ -40,6 +61,11 @@ namespace Soundux
             virtual bool revertDefault() = 0;
             virtual bool muteInput(bool) = 0;
 
+            //* The input stays muted from the first sound that is played until all sounds finished, so repeated
+            //* triggers during a session do not reach the sound server
+            bool startMuteSession();
+            bool endMuteSession();
+
             virtual std::set<std::string> currentlyInputApps() = 0;
             virtual std::set<std::string> currentlyPassedThrough() = 0;
 
@@ -55,6 +81,11 @@ namespace Soundux
 
             virtual std::vector<std::shared_ptr<PlaybackApp>> getPlaybackApps() = 0;
             virtual std::vector<std::shared_ptr<RecordingApp>> getRecordingApps() = 0;
+
+            //* Backends that can take audio from us directly, without going through miniaudio and a null sink
+            virtual std::optional<NativeOutput> getNativeOutput();
+            //* The processing cycle of the sound server, if it has a fixed one
+            virtual std::optional<GraphClock> getGraphClock();
         };
     } // namespace Objects
 } // namespace Soundux
@@ -27,10 +27,14 @@ bool Soundux::PipeWireApi::setup()
 #define load(name) loadFunc(libpulse, name, stringify(pw_##name))
             load(init);
             load(context_new);
-            load(main_loop_run);
-            load(main_loop_new);
             load(proxy_destroy);
-            load(main_loop_quit);
+            load(thread_loop_new);
+            load(thread_loop_lock);
+            load(thread_loop_wait);
+            load(thread_loop_stop);
+            load(thread_loop_start);
+            load(thread_loop_signal);
+            load(thread_loop_unlock);
             load(properties_new);
             load(properties_set);
             load(context_connect);
@@ -38,9 +42,18 @@ bool Soundux::PipeWireApi::setup()
             load(context_destroy);
             load(properties_free);
             load(core_disconnect);
-            load(main_loop_destroy);
-            load(main_loop_get_loop);
+            load(thread_loop_destroy);
+            load(thread_loop_get_loop);
             load(proxy_add_listener);
+            load(stream_new);
+            load(stream_connect);
+            load(stream_destroy);
+            load(stream_add_listener);
+            load(stream_queue_buffer);
+            load(stream_dequeue_buffer);
+
+            check_library_version = reinterpret_cast<decltype(check_library_version)>(
+                dlsym(libpulse, "pw_check_library_version"));
             return true;
         }
         catch (std::exception &e)
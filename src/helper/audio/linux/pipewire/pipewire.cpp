@@ -1,64 +1,107 @@
 #if defined(__linux__)
 #include "pipewire.hpp"
 #include "forward.hpp"
+#include <core/global/globals.hpp>
 #include <fancy.hpp>
+#include <cstdlib>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace Soundux::Objects
 {
-    void PipeWire::sync()
+    //* The loop lock is recursive, but waiting on the loop only releases it once. So we make sure that every thread
+    //* only ever holds each loop once, no matter how deep it is nested.
+    class ThreadLoopLock
     {
-        spa_hook coreListener;
-        int pending = 0;
+        pw_thread_loop *loop;
 
-        pw_core_events coreEvents = {};
-        coreEvents.version = PW_VERSION_CORE_EVENTS;
-        coreEvents.done = [](void *data, uint32_t id, int seq) {
-            auto *info = reinterpret_cast<std::pair<PipeWire *, int *> *>(data);
-            if (info)
+        static std::unordered_map<pw_thread_loop *, std::size_t> &depths()
+        {
+            static thread_local std::unordered_map<pw_thread_loop *, std::size_t> depths;
+            return depths;
+        }
+
+      public:
+        ThreadLoopLock(const ThreadLoopLock &) = delete;
+        ThreadLoopLock &operator=(const ThreadLoopLock &) = delete;
+
+        explicit ThreadLoopLock(pw_thread_loop *loop) : loop(loop)
+        {
+            if (depths()[loop]++ == 0)
             {
-                if (id == PW_ID_CORE && seq == *info->second)
-                {
-                    *info->second = -1;
-                    PipeWireApi::main_loop_quit(info->first->loop);
-                }
+                PipeWireApi::thread_loop_lock(loop);
             }
-        };
-        coreEvents.error = [](void *data, std::uint32_t id, int seq, int res, const char *message) {
-            auto *info = reinterpret_cast<std::pair<PipeWire *, int *> *>(data);
-            if (info)
+        }
+        ~ThreadLoopLock()
+        {
+            auto depth = depths().find(loop);
+            if (--depth->second == 0)
             {
-                if (id == PW_ID_CORE && seq == *info->second)
-                {
-                    Fancy::fancy.logTime()
-                        << "Core Failure - Seq " << seq << " - Res " << res << ": " << message << std::endl;
+                depths().erase(depth);
+                PipeWireApi::thread_loop_unlock(loop);
+            }
+        }
+    };
 
-                    *info->second = -1;
-                    PipeWireApi::main_loop_quit(info->first->loop);
+    static void indexPort(PortIndex &index, const Port &port)
+    {
+        index[port.direction][port.side].emplace(port.id);
+    }
+    static void unindexNode(std::map<std::string, std::set<std::uint32_t>> &index, const Node &node)
+    {
+        if (auto binary = index.find(node.applicationBinary); binary != index.end())
+        {
+            binary->second.erase(node.id);
+            if (binary->second.empty())
+            {
+                index.erase(binary);
+            }
+        }
+    }
+    static void unindexPort(PortIndex &index, const Port &port)
+    {
+        auto direction = index.find(port.direction);
+        if (direction != index.end())
+        {
+            auto side = direction->second.find(port.side);
+            if (side != direction->second.end())
+            {
+                side->second.erase(port.id);
+                if (side->second.empty())
+                {
+                    direction->second.erase(side);
                 }
             }
-        };
+            if (direction->second.empty())
+            {
+                index.erase(direction);
+            }
+        }
+    }
 
-        auto data = std::make_pair(this, &pending);
-        pw_core_add_listener(core, &coreListener, &coreEvents, &data); // NOLINT
+    void PipeWire::sync()
+    {
+        //! Must never be called from the loop thread (i.e. from within an event), it would wait forever
+        ThreadLoopLock lock(loop);
 
-        pending = pw_core_sync(core, PW_ID_CORE, 0); // NOLINT
-        while (pending != -1)
+        syncDone = false;
+        pendingSync = pw_core_sync(core, PW_ID_CORE, pendingSync); // NOLINT
+
+        while (!syncDone)
         {
-            PipeWireApi::main_loop_run(loop);
+            PipeWireApi::thread_loop_wait(loop);
         }
-
-        spa_hook_remove(&coreListener);
     }
 
     void PipeWire::onNodeInfo(const pw_node_info *info)
     {
-        if (info && (~nodes).find(info->id) != (~nodes).end())
+        auto scopedNodes = nodes.scoped();
+        if (info && info->props && scopedNodes->find(info->id) != scopedNodes->end())
         {
-            auto &self = (~nodes).at(info->id);
+            auto &self = scopedNodes->at(info->id);
 
             if (const auto *pid = spa_dict_lookup(info->props, "application.process.id"); pid)
             {
@@ -74,18 +117,33 @@ namespace Soundux::Objects
             {
                 self.name = appName;
             }
-            if (const auto *binary = spa_dict_lookup(info->props, "application.process.binary"); binary)
+            if (const auto *binary = spa_dict_lookup(info->props, "application.process.binary");
+                binary && self.applicationBinary != binary)
             {
+                unindexNode(binaryNodes, self);
                 self.applicationBinary = binary;
+                binaryNodes[self.applicationBinary].emplace(self.id);
             }
         }
     }
 
     void PipeWire::onPortInfo(const pw_port_info *info)
     {
-        if (info && (~ports).find(info->id) != (~ports).end())
+        auto scopedNodes = nodes.scoped();
+        auto scopedPorts = ports.scoped();
+        if (info && info->props && scopedPorts->find(info->id) != scopedPorts->end())
         {
-            auto &self = (~ports).at(info->id);
+            auto &self = scopedPorts->at(info->id);
+            auto *parent = scopedNodes->find(self.parentNode) != scopedNodes->end() ? &scopedNodes->at(self.parentNode)
+                                                                                   : nullptr;
+
+            //* The side or direction might change with this update, so we drop the port from the indices first
+            unindexPort(ownPorts, self);
+            if (parent)
+            {
+                unindexPort(parent->portIndex, self);
+            }
+
             self.direction = info->direction;
 
             if (const auto *nodeId = spa_dict_lookup(info->props, "node.id"); nodeId)
@@ -113,9 +171,96 @@ namespace Soundux::Objects
             {
                 self.portAlias = std::string(portAlias);
             }
+
+            //* Ports of our own nodes have no parent in `nodes`, they are only kept in `ports`
+            if (self.parentNode > 0 && scopedNodes->find(self.parentNode) != scopedNodes->end())
+            {
+                auto &node = scopedNodes->at(self.parentNode);
+                node.ports.insert_or_assign(self.id, self);
+                indexPort(node.portIndex, self);
+            }
+            else if (self.portAlias.find("soundux") != std::string::npos)
+            {
+                indexPort(ownPorts, self);
+            }
+        }
+    }
+
+    void PipeWire::onMetadataProperty(const char *key, const char *value)
+    {
+        if (strcmp(key, "default.audio.sink") == 0)
+        {
+            Globals::gAudio.invalidateDevices();
+            return;
+        }
+        if (strcmp(key, "default.audio.source") == 0 && value)
+        {
+            auto parsedValue = nlohmann::json::parse(value, nullptr, false);
+            if (!parsedValue.is_discarded() && parsedValue.count("name"))
+            {
+                auto name = parsedValue["name"].get<std::string>();
+
+                defaultMicrophone = name;
+                Fancy::fancy.logTime().message() << "Found default device: " << name << std::endl;
+
+                microphoneNode.reset();
+                for (const auto &[id, node] : *nodes.scoped())
+                {
+                    if (node.rawName == name)
+                    {
+                        microphoneNode = id;
+                        break;
+                    }
+                }
+            }
+
+            return;
+        }
+
+        //* The clock settings live in the "settings" metadata, a removed property (i.e. no value) resets it
+        std::atomic<std::uint32_t> *clockSetting = nullptr;
+        if (strcmp(key, "clock.rate") == 0)
+        {
+            clockSetting = &clockRate;
+        }
+        else if (strcmp(key, "clock.quantum") == 0)
+        {
+            clockSetting = &clockQuantum;
+        }
+        else if (strcmp(key, "clock.force-rate") == 0)
+        {
+            clockSetting = &forcedClockRate;
+        }
+        else if (strcmp(key, "clock.force-quantum") == 0)
+        {
+            clockSetting = &forcedClockQuantum;
+        }
+
+        if (clockSetting)
+        {
+            auto parsed = value ? static_cast<std::uint32_t>(std::strtoul(value, nullptr, 10)) : 0;
+            if (clockSetting->exchange(parsed) != parsed && Globals::gSettings.latencyMode == Enums::LatencyMode::Auto)
+            {
+                //* We're on the loop thread here, so we let the queue re-tune the audio engine
+                Globals::gQueue.push_unique(reinterpret_cast<std::uintptr_t>(&clockQuantum),
+                                            [] { Globals::gAudio.tuneLatency(); });
+            }
         }
     }
 
+    std::optional<GraphClock> PipeWire::getGraphClock()
+    {
+        auto rate = forcedClockRate ? forcedClockRate.load() : clockRate.load();
+        auto quantum = forcedClockQuantum ? forcedClockQuantum.load() : clockQuantum.load();
+
+        if (!rate || !quantum)
+        {
+            return std::nullopt;
+        }
+
+        return GraphClock{rate, quantum};
+    }
+
     void PipeWire::onCoreInfo(const pw_core_info *info)
     {
         if (info && info->name && info->version && !version)
@@ -138,69 +283,39 @@ namespace Soundux::Objects
     }
 
     void PipeWire::onGlobalAdded(void *data, std::uint32_t id, [[maybe_unused]] std::uint32_t perms, const char *type,
-                                 [[maybe_unused]] std::uint32_t version, const spa_dict *props)
+                                 std::uint32_t version, const spa_dict *props)
     {
+        //* Runs on the loop thread. We keep every proxy bound, so that their info events keep our model up to date
+        //* without ever having to wait for a round trip here.
         auto *thiz = reinterpret_cast<PipeWire *>(data);
         if (thiz && props)
         {
-            if (strcmp(type, PW_TYPE_INTERFACE_Core) == 0)
-            {
-                spa_hook listener;
-                pw_core_events events = {};
-
-                events.info = [](void *data, const pw_core_info *info) {
-                    auto *thiz = reinterpret_cast<PipeWire *>(data);
-                    if (thiz)
-                    {
-                        thiz->onCoreInfo(info);
-                    }
-                };
-                events.version = PW_VERSION_CORE_EVENTS;
-                auto *boundCore = reinterpret_cast<pw_core *>(
-                    pw_registry_bind(thiz->registry, id, type, PW_VERSION_CORE, sizeof(PipeWire)));
-
-                if (boundCore)
-                {
-                    pw_core_add_listener(boundCore, &listener, &events, thiz); // NOLINT
-                    thiz->sync();
-                    spa_hook_remove(&listener);
-                    PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(boundCore));
-                }
-            }
             if (strcmp(type, PW_TYPE_INTERFACE_Metadata) == 0)
             {
-                spa_hook listener;
-                pw_metadata_events events = {};
-
-                events.property = [](void *userdata, [[maybe_unused]] std::uint32_t id, const char *key,
-                                     [[maybe_unused]] const char *type, const char *value) -> int {
-                    auto *thiz = reinterpret_cast<PipeWire *>(userdata);
-                    if (thiz && key && value)
-                    {
-                        if (strcmp(key, "default.audio.source") == 0)
+                static const pw_metadata_events events = [] {
+                    pw_metadata_events events = {};
+                    events.version = PW_VERSION_METADATA_EVENTS;
+                    events.property = [](void *userdata, [[maybe_unused]] std::uint32_t id, const char *key,
+                                         [[maybe_unused]] const char *type, const char *value) -> int {
+                        auto *thiz = reinterpret_cast<PipeWire *>(userdata);
+                        if (thiz && key)
                         {
-                            auto parsedValue = nlohmann::json::parse(value, nullptr, false);
-                            if (!parsedValue.is_discarded() && parsedValue.count("name"))
-                            {
-                                auto name = parsedValue["name"].get<std::string>();
-
-                                thiz->defaultMicrophone = name;
-                                Fancy::fancy.logTime().message() << "Found default device: " << name << std::endl;
-                            }
+                            thiz->onMetadataProperty(key, value);
                         }
-                    }
-                    return 0;
-                };
+                        return 0;
+                    };
+                    return events;
+                }();
 
-                auto *boundMetaData = reinterpret_cast<pw_metadata *>(
-                    pw_registry_bind(thiz->registry, id, type, PW_VERSION_METADATA, sizeof(PipeWire)));
+                auto bound = std::make_unique<BoundProxy>();
+                bound->proxy = reinterpret_cast<pw_proxy *>(
+                    pw_registry_bind(thiz->registry, id, type, PW_VERSION_METADATA, 0));
 
-                if (boundMetaData)
+                if (bound->proxy)
                 {
-                    pw_metadata_add_listener(boundMetaData, &listener, &events, thiz); // NOLINT
-                    thiz->sync();
-                    spa_hook_remove(&listener);
-                    PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(boundMetaData));
+                    pw_metadata_add_listener(reinterpret_cast<pw_metadata *>(bound->proxy), // NOLINT
+                                             &bound->listener, &events, thiz);
+                    thiz->proxies.insert_or_assign(id, std::move(bound));
                 }
             }
             if (strcmp(type, PW_TYPE_INTERFACE_Node) == 0)
@@ -211,73 +326,74 @@ namespace Soundux::Objects
                     return;
                 }
 
+                static const pw_node_events events = [] {
+                    pw_node_events events = {};
+                    events.version = PW_VERSION_NODE_EVENTS;
+                    events.info = [](void *data, const pw_node_info *info) {
+                        auto *thiz = reinterpret_cast<PipeWire *>(data);
+                        if (thiz)
+                        {
+                            thiz->onNodeInfo(info);
+                        }
+                    };
+                    return events;
+                }();
+
                 Node node;
                 node.id = id;
-                node.rawName = name;
+                node.rawName = name ? name : "";
 
-                spa_hook listener;
-                pw_node_events events = {};
+                auto bound = std::make_unique<BoundProxy>();
+                bound->proxy =
+                    reinterpret_cast<pw_proxy *>(pw_registry_bind(thiz->registry, id, type, PW_VERSION_NODE, 0));
 
-                events.info = [](void *data, const pw_node_info *info) {
-                    auto *thiz = reinterpret_cast<PipeWire *>(data);
-                    if (thiz)
+                if (const auto *mediaClass = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+                    mediaClass && strcmp(mediaClass, "Audio/Sink") == 0)
+                {
+                    node.isSink = true;
+                    Globals::gAudio.invalidateDevices();
+                }
+
+                if (bound->proxy)
+                {
+                    if (node.rawName == thiz->defaultMicrophone)
                     {
-                        thiz->onNodeInfo(info);
+                        thiz->microphoneNode = id;
                     }
-                };
-                events.version = PW_VERSION_NODE_EVENTS;
-                auto *boundNode = reinterpret_cast<pw_node *>(
-                    pw_registry_bind(thiz->registry, id, type, PW_VERSION_NODE, sizeof(PipeWire)));
 
-                if (boundNode)
-                {
-                    thiz->nodes->emplace(id, node);
-                    pw_node_add_listener(boundNode, &listener, &events, thiz); // NOLINT
-                    thiz->sync();
-                    spa_hook_remove(&listener);
-                    PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(boundNode));
+                    thiz->nodes->insert_or_assign(id, node);
+                    pw_node_add_listener(reinterpret_cast<pw_node *>(bound->proxy), // NOLINT
+                                         &bound->listener, &events, thiz);
+                    thiz->proxies.insert_or_assign(id, std::move(bound));
                 }
             }
             if (strcmp(type, PW_TYPE_INTERFACE_Port) == 0)
             {
+                static const pw_port_events events = [] {
+                    pw_port_events events = {};
+                    events.version = PW_VERSION_PORT_EVENTS;
+                    events.info = [](void *data, const pw_port_info *info) {
+                        auto *thiz = reinterpret_cast<PipeWire *>(data);
+                        if (thiz)
+                        {
+                            thiz->onPortInfo(info);
+                        }
+                    };
+                    return events;
+                }();
+
                 Port port;
                 port.id = id;
 
-                spa_hook listener;
-                pw_port_events events = {};
-
-                events.info = [](void *data, const pw_port_info *info) {
-                    auto *thiz = reinterpret_cast<PipeWire *>(data);
-                    if (thiz)
-                    {
-                        thiz->onPortInfo(info);
-                    }
-                };
-                events.version = PW_VERSION_PORT_EVENTS;
-
-                auto *boundPort =
-                    reinterpret_cast<pw_port *>(pw_registry_bind(thiz->registry, id, type, version, sizeof(PipeWire)));
+                auto bound = std::make_unique<BoundProxy>();
+                bound->proxy = reinterpret_cast<pw_proxy *>(pw_registry_bind(thiz->registry, id, type, version, 0));
 
-                if (boundPort)
+                if (bound->proxy)
                 {
-                    thiz->ports->emplace(id, port);
-                    pw_port_add_listener(boundPort, &listener, &events, thiz); // NOLINT
-                    thiz->sync();
-                    spa_hook_remove(&listener);
-                    PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(boundPort));
-
-                    auto scopedNodes = thiz->nodes.scoped();
-                    auto scopedPorts = thiz->ports.scoped();
-                    if (scopedPorts->find(id) != scopedPorts->end())
-                    {
-                        auto &port = scopedPorts->at(id);
-                        if (port.parentNode > 0 && scopedNodes->find(port.parentNode) != scopedNodes->end())
-                        {
-                            auto &node = scopedNodes->at(port.parentNode);
-                            node.ports.emplace(id, port);
-                            scopedPorts->erase(id);
-                        }
-                    }
+                    thiz->ports->insert_or_assign(id, port);
+                    pw_port_add_listener(reinterpret_cast<pw_port *>(bound->proxy), // NOLINT
+                                         &bound->listener, &events, thiz);
+                    thiz->proxies.insert_or_assign(id, std::move(bound));
                 }
             }
         }
@@ -288,35 +404,73 @@ namespace Soundux::Objects
         auto *thiz = reinterpret_cast<PipeWire *>(data);
         if (thiz)
         {
+            thiz->release(id);
+
+            if (thiz->microphoneNode == id)
+            {
+                thiz->microphoneNode.reset();
+            }
+
             auto scopedNodes = thiz->nodes.scoped();
-            if (scopedNodes->find(id) != scopedNodes->end())
+            if (auto node = scopedNodes->find(id); node != scopedNodes->end())
             {
-                scopedNodes->erase(id);
+                if (node->second.isSink)
+                {
+                    Globals::gAudio.invalidateDevices();
+                }
+
+                unindexNode(thiz->binaryNodes, node->second);
+                scopedNodes->erase(node);
             }
 
             auto scopedPorts = thiz->ports.scoped();
-            if (scopedPorts->find(id) != scopedPorts->end())
+            if (auto port = scopedPorts->find(id); port != scopedPorts->end())
             {
-                scopedPorts->erase(id);
+                if (auto node = scopedNodes->find(port->second.parentNode); node != scopedNodes->end())
+                {
+                    node->second.ports.erase(id);
+                    unindexPort(node->second.portIndex, port->second);
+                }
+                unindexPort(thiz->ownPorts, port->second);
+
+                scopedPorts->erase(port);
             }
         }
     }
 
+    void PipeWire::release(std::uint32_t id)
+    {
+        ThreadLoopLock lock(loop);
+
+        if (auto bound = proxies.find(id); bound != proxies.end())
+        {
+            spa_hook_remove(&bound->second->listener);
+            PipeWireApi::proxy_destroy(bound->second->proxy);
+            proxies.erase(bound);
+        }
+    }
+
     bool PipeWire::setup()
     {
+        TraceScope scope("PipeWire::setup");
+
         if (!PipeWireApi::setup())
         {
             return false;
         }
 
         PipeWireApi::init(nullptr, nullptr);
-        loop = PipeWireApi::main_loop_new(nullptr);
+        hasRequested = PipeWireApi::check_library_version && PipeWireApi::check_library_version(0, 3, 49);
+
+        loop = PipeWireApi::thread_loop_new("soundux", nullptr);
         if (!loop)
         {
-            Fancy::fancy.logTime().failure() << "Failed to create main loop" << std::endl;
+            Fancy::fancy.logTime().failure() << "Failed to create thread loop" << std::endl;
             return false;
         }
-        context = PipeWireApi::context_new(PipeWireApi::main_loop_get_loop(loop), nullptr, 0);
+
+        ThreadLoopLock lock(loop);
+        context = PipeWireApi::context_new(PipeWireApi::thread_loop_get_loop(loop), nullptr, 0);
         if (!context)
         {
             Fancy::fancy.logTime().failure() << "Failed to create context" << std::endl;
@@ -328,6 +482,32 @@ namespace Soundux::Objects
             Fancy::fancy.logTime().failure() << "Failed to connect context" << std::endl;
             return false;
         }
+
+        coreEvents.version = PW_VERSION_CORE_EVENTS;
+        coreEvents.info = [](void *data, const pw_core_info *info) {
+            reinterpret_cast<PipeWire *>(data)->onCoreInfo(info);
+        };
+        coreEvents.done = [](void *data, std::uint32_t id, int seq) {
+            auto *thiz = reinterpret_cast<PipeWire *>(data);
+            if (id == PW_ID_CORE && seq == thiz->pendingSync)
+            {
+                thiz->syncDone = true;
+                PipeWireApi::thread_loop_signal(thiz->loop, false);
+            }
+        };
+        coreEvents.error = [](void *data, std::uint32_t id, int seq, int res, const char *message) {
+            auto *thiz = reinterpret_cast<PipeWire *>(data);
+            if (id == PW_ID_CORE && seq == thiz->pendingSync)
+            {
+                Fancy::fancy.logTime() << "Core Failure - Seq " << seq << " - Res " << res << ": " << message
+                                       << std::endl;
+
+                thiz->syncDone = true;
+                PipeWireApi::thread_loop_signal(thiz->loop, false);
+            }
+        };
+        pw_core_add_listener(core, &coreListener, &coreEvents, this); // NOLINT
+
         registry = pw_core_get_registry(core, PW_VERSION_REGISTRY, 0);
         if (!registry)
         {
@@ -341,6 +521,15 @@ namespace Soundux::Objects
 
         pw_registry_add_listener(registry, &registryListener, &registryEvents, this); // NOLINT
 
+        if (PipeWireApi::thread_loop_start(loop) < 0)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to start thread loop" << std::endl;
+            return false;
+        }
+
+        //* The first round trip delivers all globals (which we bind right away), the second one the initial info of
+        //* everything we've bound. From then on the model is kept up to date by events alone.
+        sync();
         sync();
 
         if (defaultMicrophone.empty())
@@ -348,19 +537,85 @@ namespace Soundux::Objects
             Fancy::fancy.logTime().warning() << "Failed to retrieve default microphone" << std::endl;
         }
 
-        return createNullSink();
+        //* The null sink is still needed for passthrough, the native output only replaces it for playing sounds
+        if (!createNullSink())
+        {
+            return false;
+        }
+
+        if (Globals::gSettings.nativeOutput && !createStream())
+        {
+            Fancy::fancy.logTime().warning()
+                << "Failed to create native output, falling back to null sink" << std::endl;
+        }
+
+        return true;
     }
 
     void PipeWire::destroy()
     {
-        PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(registry));
-        PipeWireApi::core_disconnect(core);
-        PipeWireApi::context_destroy(context);
-        PipeWireApi::main_loop_destroy(loop);
+        disconnect();
+    }
+
+    PipeWire::~PipeWire()
+    {
+        disconnect();
+    }
+
+    void PipeWire::disconnect()
+    {
+        if (!loop)
+        {
+            return;
+        }
+
+        //* Stopping the loop must not happen while holding the lock, afterwards we own everything exclusively
+        PipeWireApi::thread_loop_stop(loop);
+
+        if (stream)
+        {
+            spa_hook_remove(&streamListener);
+            PipeWireApi::stream_destroy(stream);
+
+            stream = nullptr;
+            nativeOutput.reset();
+        }
+
+        for (auto &[id, bound] : proxies)
+        {
+            spa_hook_remove(&bound->listener);
+            PipeWireApi::proxy_destroy(bound->proxy);
+        }
+        proxies.clear();
+
+        if (registry)
+        {
+            spa_hook_remove(&registryListener);
+            PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(registry));
+        }
+        if (core)
+        {
+            spa_hook_remove(&coreListener);
+            PipeWireApi::core_disconnect(core);
+        }
+        if (context)
+        {
+            PipeWireApi::context_destroy(context);
+        }
+        PipeWireApi::thread_loop_destroy(loop);
+
+        core = nullptr;
+        loop = nullptr;
+        context = nullptr;
+        registry = nullptr;
     }
 
     bool PipeWire::createNullSink()
     {
+        TraceScope scope("PipeWire::createNullSink");
+
+        ThreadLoopLock lock(loop);
+
         pw_properties *props = PipeWireApi::properties_new(nullptr, nullptr);
 
         PipeWireApi::properties_set(props, PW_KEY_MEDIA_CLASS, "Audio/Sink");
@@ -396,75 +651,285 @@ namespace Soundux::Objects
         return success;
     }
 
-    bool PipeWire::deleteLink(std::uint32_t id)
+    bool PipeWire::createStream()
     {
-        pw_registry_destroy(registry, id); // NOLINT
+        ThreadLoopLock lock(loop);
+
+        static const pw_stream_events events = [] {
+            pw_stream_events events = {};
+            events.version = PW_VERSION_STREAM_EVENTS;
+            events.process = onProcess;
+            events.state_changed = []([[maybe_unused]] void *data, [[maybe_unused]] pw_stream_state old,
+                                      pw_stream_state state, const char *error) {
+                if (state == PW_STREAM_STATE_ERROR)
+                {
+                    Fancy::fancy.logTime().failure() << "Native output failed: " << (error ? error : "") << std::endl;
+                }
+            };
+            return events;
+        }();
+
+        //* Matching the graph rate spares PipeWire from resampling our output
+        auto clock = getGraphClock();
+        NativeOutput output{clock ? clock->rate : 48000, 2};
+
+        //* Mixing happens on the realtime thread, which must not allocate
+        Globals::gAudio.prepareMix(std::max<std::uint32_t>(clock ? clock->quantum : 0, 1024), output.channels);
+
+        //* The node description ends up in the port aliases, which is how we recognize our own ports
+        auto *props = PipeWireApi::properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY, "Playback",
+                                                  PW_KEY_NODE_NAME, "soundux_output", PW_KEY_NODE_DESCRIPTION,
+                                                  "soundux_output", nullptr);
+
+        stream = PipeWireApi::stream_new(core, "soundux", props);
+        if (!stream)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to create stream" << std::endl;
+            return false;
+        }
+
+        PipeWireApi::stream_add_listener(stream, &streamListener, &events, this);
+
+        spa_audio_info_raw info{};
+        info.format = SPA_AUDIO_FORMAT_F32;
+        info.rate = output.sampleRate;
+        info.channels = output.channels;
+        info.position[0] = SPA_AUDIO_CHANNEL_FL;
+        info.position[1] = SPA_AUDIO_CHANNEL_FR;
+
+        char buffer[1024];
+        spa_pod_builder b;
+        spa_pod_builder_init(&b, buffer, sizeof(buffer));
+        const auto *format = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &info);
+
+        //* We don't autoconnect, the stream is linked to the output apps just like the null sink
+        auto flags = static_cast<pw_stream_flags>(PW_STREAM_FLAG_MAP_BUFFERS | PW_STREAM_FLAG_RT_PROCESS);
+        if (PipeWireApi::stream_connect(stream, PW_DIRECTION_OUTPUT, PW_ID_ANY, flags, &format, 1) < 0)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to connect stream" << std::endl;
+
+            spa_hook_remove(&streamListener);
+            PipeWireApi::stream_destroy(stream);
+            stream = nullptr;
+
+            return false;
+        }
+
         sync();
 
+        nativeOutput = output;
         return true;
     }
 
-    std::optional<int> PipeWire::linkPorts(std::uint32_t in, std::uint32_t out)
+    void PipeWire::onProcess(void *data)
     {
-        pw_properties *props = PipeWireApi::properties_new(nullptr, nullptr);
+        //* Runs on the realtime thread of the loop
+        auto *thiz = reinterpret_cast<PipeWire *>(data);
 
-        PipeWireApi::properties_set(props, PW_KEY_APP_NAME, "soundux");
-        PipeWireApi::properties_setf(props, PW_KEY_LINK_INPUT_PORT, "%u", in);
-        PipeWireApi::properties_setf(props, PW_KEY_LINK_OUTPUT_PORT, "%u", out);
+        auto *buffer = PipeWireApi::stream_dequeue_buffer(thiz->stream);
+        if (!buffer)
+        {
+            return;
+        }
 
-        auto *proxy = reinterpret_cast<pw_proxy *>(
-            pw_core_create_object(core, "link-factory", PW_TYPE_INTERFACE_Link, PW_VERSION_LINK, &props->dict, 0));
+        auto &raw = buffer->buffer->datas[0];
+        if (!raw.data)
+        {
+            PipeWireApi::stream_queue_buffer(thiz->stream, buffer);
+            return;
+        }
 
-        if (!proxy)
+        auto stride = static_cast<std::uint32_t>(sizeof(float)) * thiz->nativeOutput->channels;
+        auto frames = raw.maxsize / stride;
+#if PW_CHECK_VERSION(0, 3, 49)
+        if (thiz->hasRequested && buffer->requested)
         {
-            Fancy::fancy.logTime().warning() << "Failed to create link from " << in << " to " << out << std::endl;
-            PipeWireApi::properties_free(props);
-            return std::nullopt;
+            frames = std::min<std::uint32_t>(frames, static_cast<std::uint32_t>(buffer->requested));
         }
+#endif
 
-        spa_hook listener;
-        std::optional<std::uint32_t> result;
+        Globals::gAudio.mix(static_cast<float *>(raw.data), frames, thiz->nativeOutput->channels);
 
-        pw_proxy_events linkEvent = {};
-        linkEvent.version = PW_VERSION_PROXY_EVENTS;
-        linkEvent.bound = [](void *data, std::uint32_t id) {
-            *reinterpret_cast<std::optional<std::uint32_t> *>(data) = id;
-        };
-        linkEvent.error = [](void *data, [[maybe_unused]] int a, [[maybe_unused]] int b, const char *message) {
-            Fancy::fancy.logTime().warning() << "Failed to create link: " << message << std::endl;
-            *reinterpret_cast<std::optional<std::uint32_t> *>(data) = std::nullopt;
+        raw.chunk->offset = 0;
+        raw.chunk->stride = static_cast<std::int32_t>(stride);
+        raw.chunk->size = frames * stride;
+
+        PipeWireApi::stream_queue_buffer(thiz->stream, buffer);
+    }
+
+    std::optional<NativeOutput> PipeWire::getNativeOutput()
+    {
+        return nativeOutput;
+    }
+
+    void PipeWire::deleteLinks(const std::vector<std::uint32_t> &links)
+    {
+        if (links.empty())
+        {
+            return;
+        }
+
+        ThreadLoopLock lock(loop);
+        for (const auto &id : links)
+        {
+            pw_registry_destroy(registry, id); // NOLINT
+        }
+
+        sync();
+    }
+
+    std::vector<std::uint32_t> PipeWire::linkPorts(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &ports)
+    {
+        struct PendingLink
+        {
+            spa_hook listener{};
+            bool listening = false;
+            pw_properties *props = nullptr;
+            std::optional<std::uint32_t> id;
         };
 
-        PipeWireApi::proxy_add_listener(proxy, &listener, &linkEvent, &result);
+        if (ports.empty())
+        {
+            return {};
+        }
+
+        static const pw_proxy_events events = [] {
+            pw_proxy_events events = {};
+            events.version = PW_VERSION_PROXY_EVENTS;
+            events.bound = [](void *data, std::uint32_t id) { reinterpret_cast<PendingLink *>(data)->id = id; };
+            events.error = [](void *data, [[maybe_unused]] int a, [[maybe_unused]] int b, const char *message) {
+                Fancy::fancy.logTime().warning() << "Failed to create link: " << message << std::endl;
+                reinterpret_cast<PendingLink *>(data)->id = std::nullopt;
+            };
+            return events;
+        }();
+
+        ThreadLoopLock lock(loop);
+
+        //* All links are requested at once, a single round trip afterwards tells us which of them were created
+        std::vector<PendingLink> pending(ports.size());
+        for (std::size_t i = 0; ports.size() > i; i++)
+        {
+            const auto &[in, out] = ports[i];
+            auto &link = pending[i];
+
+            link.props = PipeWireApi::properties_new(nullptr, nullptr);
+            PipeWireApi::properties_set(link.props, PW_KEY_APP_NAME, "soundux");
+            PipeWireApi::properties_setf(link.props, PW_KEY_LINK_INPUT_PORT, "%u", in);
+            PipeWireApi::properties_setf(link.props, PW_KEY_LINK_OUTPUT_PORT, "%u", out);
+
+            auto *proxy = reinterpret_cast<pw_proxy *>(pw_core_create_object(
+                core, "link-factory", PW_TYPE_INTERFACE_Link, PW_VERSION_LINK, &link.props->dict, 0));
+
+            if (!proxy)
+            {
+                Fancy::fancy.logTime().warning() << "Failed to create link from " << in << " to " << out << std::endl;
+                continue;
+            }
+
+            PipeWireApi::proxy_add_listener(proxy, &link.listener, &events, &link);
+            link.listening = true;
+        }
+
         sync();
 
-        spa_hook_remove(&listener);
-        PipeWireApi::properties_free(props);
+        std::vector<std::uint32_t> rtn;
+        for (auto &link : pending)
+        {
+            if (link.listening)
+            {
+                spa_hook_remove(&link.listener);
+            }
+            if (link.id)
+            {
+                rtn.emplace_back(*link.id);
+            }
 
-        return result;
+            PipeWireApi::properties_free(link.props);
+        }
+
+        return rtn;
     }
 
-    std::vector<std::shared_ptr<RecordingApp>> PipeWire::getRecordingApps()
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> PipeWire::matchPorts(const std::string &application,
+                                                                            spa_direction direction)
     {
-        sync();
-        std::vector<std::shared_ptr<RecordingApp>> rtn;
+        //* Returns pairs of (input, output) ports connecting our own ports with the given direction of the app.
+        //* A mono port of the app is connected to every side of ours.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> rtn;
+        auto ownDirection = direction == SPA_DIRECTION_INPUT ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT;
 
         auto scopedNodes = nodes.scoped();
-        for (const auto &[nodeId, node] : *scopedNodes)
+        auto scopedPorts = ports.scoped(); //* Guards `ownPorts`
+
+        auto own = ownPorts.find(ownDirection);
+        if (own == ownPorts.end())
         {
-            if (!node.name.empty() && !node.isMonitor)
+            return rtn;
+        }
+
+        auto appNodes = binaryNodes.find(application);
+        if (appNodes == binaryNodes.end())
+        {
+            return rtn;
+        }
+
+        for (const auto &nodeId : appNodes->second)
+        {
+            const auto &node = scopedNodes->at(nodeId);
+
+            auto appPorts = node.portIndex.find(direction);
+            if (appPorts == node.portIndex.end())
+                continue;
+
+            for (const auto &[side, ownIds] : own->second)
             {
-                bool hasInput = false;
-                for (const auto &[portId, port] : node.ports)
+                if (side == Side::UNDEFINED)
+                    continue;
+
+                std::vector<Side> appSides{side};
+                if (side != Side::MONO)
+                {
+                    appSides.emplace_back(Side::MONO);
+                }
+
+                for (const auto &appSide : appSides)
                 {
-                    if (port.direction == SPA_DIRECTION_INPUT)
+                    auto appIds = appPorts->second.find(appSide);
+                    if (appIds == appPorts->second.end())
+                        continue;
+
+                    for (const auto &appId : appIds->second)
                     {
-                        hasInput = true;
-                        break;
+                        for (const auto &ownId : ownIds)
+                        {
+                            if (direction == SPA_DIRECTION_INPUT)
+                            {
+                                rtn.emplace_back(appId, ownId);
+                            }
+                            else
+                            {
+                                rtn.emplace_back(ownId, appId);
+                            }
+                        }
                     }
                 }
+            }
+        }
+
+        return rtn;
+    }
 
-                if (hasInput)
+    std::vector<std::shared_ptr<RecordingApp>> PipeWire::getRecordingApps()
+    {
+        std::vector<std::shared_ptr<RecordingApp>> rtn;
+
+        auto scopedNodes = nodes.scoped();
+        for (const auto &[nodeId, node] : *scopedNodes)
+        {
+            if (!node.name.empty() && !node.isMonitor)
+            {
+                if (node.portIndex.count(SPA_DIRECTION_INPUT))
                 {
                     PipeWireRecordingApp app;
                     app.pid = node.pid;
@@ -481,7 +946,6 @@ namespace Soundux::Objects
 
     std::vector<std::shared_ptr<PlaybackApp>> PipeWire::getPlaybackApps()
     {
-        sync();
         std::vector<std::shared_ptr<PlaybackApp>> rtn;
 
         auto scopedNodes = nodes.scoped();
@@ -489,17 +953,7 @@ namespace Soundux::Objects
         {
             if (!node.name.empty() && !node.isMonitor)
             {
-                bool hasOutput = false;
-                for (const auto &[portId, port] : node.ports)
-                {
-                    if (port.direction == SPA_DIRECTION_OUTPUT)
-                    {
-                        hasOutput = true;
-                        break;
-                    }
-                }
-
-                if (hasOutput)
+                if (node.portIndex.count(SPA_DIRECTION_OUTPUT))
                 {
                     PipeWirePlaybackApp app;
                     app.pid = node.pid;
@@ -569,43 +1023,35 @@ namespace Soundux::Objects
     bool PipeWire::muteInput(bool state)
     {
         // TODO(pipewire): Research if it's possible to mute the device instead of the node.
-        auto copy = nodes.copy();
-        for (const auto &node : copy)
-        {
-            if (node.second.rawName == defaultMicrophone)
-            {
-                auto *boundNode = reinterpret_cast<pw_node *>(pw_registry_bind(
-                    registry, node.second.id, PW_TYPE_INTERFACE_Node, PW_VERSION_NODE, sizeof(PipeWire)));
+        ThreadLoopLock lock(loop);
 
-                if (boundNode)
-                {
-                    char buffer[1024];
-                    spa_pod_builder b;
-                    spa_pod_builder_init(&b, buffer, sizeof(buffer));
-
-                    spa_pod_frame f[1];
-                    spa_pod *param{};
+        if (!microphoneNode)
+        {
+            Fancy::fancy.logTime().warning() << "Could not find default microphone node" << std::endl;
+            return false;
+        }
 
-                    spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
-                    spa_pod_builder_add(&b, SPA_PROP_mute, SPA_POD_Bool(state), 0);
+        auto bound = proxies.find(*microphoneNode);
+        if (bound == proxies.end())
+        {
+            return false;
+        }
 
-                    param = static_cast<spa_pod *>(spa_pod_builder_pop(&b, &f[0]));
-                    if (pw_node_set_param(boundNode, SPA_PARAM_Props, 0, param) < 0) // NOLINT
-                    {
-                        return false;
-                    }
+        char buffer[1024];
+        spa_pod_builder b;
+        spa_pod_builder_init(&b, buffer, sizeof(buffer));
 
-                    PipeWireApi::proxy_destroy(reinterpret_cast<pw_proxy *>(boundNode));
-                    sync();
+        spa_pod_frame f[1];
+        spa_pod *param{};
 
-                    return true;
-                }
+        spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_Props, SPA_PARAM_Props);
+        spa_pod_builder_add(&b, SPA_PROP_mute, SPA_POD_Bool(state), 0);
 
-                break;
-            }
-        }
+        param = static_cast<spa_pod *>(spa_pod_builder_pop(&b, &f[0]));
 
-        return false;
+        //* Fire and forget, the param is flushed by the loop and there is no reply we could wait for
+        return pw_node_set_param(reinterpret_cast<pw_node *>(bound->second->proxy), // NOLINT
+                                 SPA_PARAM_Props, 0, param) >= 0;
     }
 
     bool PipeWire::inputSoundTo(std::shared_ptr<RecordingApp> app)
@@ -628,44 +1074,16 @@ namespace Soundux::Objects
         }
 
         bool success = false;
-        auto nodes = this->nodes.copy();
-        auto ports = this->ports.copy();
 
         if (!soundInputLinks.count(app->application))
         {
             soundInputLinks.emplace(app->application, std::vector<std::uint32_t>{});
         }
 
-        for (const auto &[nodeId, node] : nodes)
+        for (const auto &link : linkPorts(matchPorts(app->application, SPA_DIRECTION_INPUT)))
         {
-            if (node.applicationBinary != app->application)
-                continue;
-
-            for (const auto &[portId, port] : ports)
-            {
-                if (port.direction == SPA_DIRECTION_OUTPUT && port.portAlias.find("soundux") != std::string::npos)
-                {
-                    for (const auto &[nodePortId, nodePort] : node.ports)
-                    {
-                        if (nodePort.direction == SPA_DIRECTION_INPUT)
-                        {
-                            if (nodePort.side == Side::UNDEFINED || port.side == Side::UNDEFINED)
-                                continue;
-
-                            if (nodePort.side == port.side || nodePort.side == Side::MONO)
-                            {
-                                auto link = linkPorts(nodePortId, portId);
-
-                                if (link)
-                                {
-                                    success = true;
-                                    soundInputLinks.at(app->application).emplace_back(*link);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            success = true;
+            soundInputLinks.at(app->application).emplace_back(link);
         }
 
         if (!success)
@@ -678,13 +1096,13 @@ namespace Soundux::Objects
 
     bool PipeWire::stopSoundInput()
     {
-        for (const auto &[appBinary, links] : soundInputLinks)
+        std::vector<std::uint32_t> links;
+        for (const auto &[appBinary, appLinks] : soundInputLinks)
         {
-            for (const auto &id : links)
-            {
-                deleteLink(id);
-            }
+            links.insert(links.end(), appLinks.begin(), appLinks.end());
         }
+
+        deleteLinks(links);
         soundInputLinks.clear();
 
         return true;
@@ -706,44 +1124,16 @@ namespace Soundux::Objects
         }
 
         bool success = false;
-        auto nodes = this->nodes.copy();
-        auto ports = this->ports.copy();
 
         if (!passthroughLinks.count(app->application))
         {
             passthroughLinks.emplace(app->application, std::vector<std::uint32_t>{});
         }
 
-        for (const auto &[nodeId, node] : nodes)
+        for (const auto &link : linkPorts(matchPorts(app->application, SPA_DIRECTION_OUTPUT)))
         {
-            if (node.applicationBinary != app->application)
-                continue;
-
-            for (const auto &[portId, port] : ports)
-            {
-                if (port.direction == SPA_DIRECTION_INPUT && port.portAlias.find("soundux") != std::string::npos)
-                {
-                    for (const auto &[nodePortId, nodePort] : node.ports)
-                    {
-                        if (nodePort.side == Side::UNDEFINED || port.side == Side::UNDEFINED)
-                            continue;
-
-                        if (nodePort.direction == SPA_DIRECTION_OUTPUT)
-                        {
-                            if (nodePort.side == port.side || nodePort.side == Side::MONO)
-                            {
-                                auto link = linkPorts(portId, nodePortId);
-
-                                if (link)
-                                {
-                                    success = true;
-                                    passthroughLinks.at(app->application).emplace_back(*link);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            success = true;
+            passthroughLinks.at(app->application).emplace_back(link);
         }
 
         if (!success)
@@ -779,11 +1169,7 @@ namespace Soundux::Objects
     {
         if (passthroughLinks.find(app) != passthroughLinks.end())
         {
-            for (const auto &id : passthroughLinks.at(app))
-            {
-                deleteLink(id);
-            }
-
+            deleteLinks(passthroughLinks.at(app));
             passthroughLinks.erase(app);
         }
         else
@@ -796,14 +1182,13 @@ namespace Soundux::Objects
 
     bool PipeWire::stopAllPassthrough()
     {
-        for (const auto &[appBinary, links] : passthroughLinks)
+        std::vector<std::uint32_t> links;
+        for (const auto &[appBinary, appLinks] : passthroughLinks)
         {
-            for (const auto &id : links)
-            {
-                deleteLink(id);
-            }
+            links.insert(links.end(), appLinks.begin(), appLinks.end());
         }
 
+        deleteLinks(links);
         passthroughLinks.clear();
         return true;
     }
@@ -1,21 +1,21 @@
 #if defined(__linux__)
 #include "../backend.hpp"
+#include <atomic>
 #include <map>
+#include <memory>
 #include <optional>
+#include <set>
 #include <var_guard.hpp>
 
 #include <pipewire/extensions/metadata.h>
 #include <pipewire/global.h>
 #include <pipewire/pipewire.h>
+#include <spa/param/audio/format-utils.h>
 #include <spa/param/props.h>
 #include <spa/pod/builder.h>
 
-// TODO(pipewire):
-//* From the pipewire news of 0.3.26
-//*   - The link factory can now also make links between nodes and
-//*     ports by name so that it can be used in scripts.
-//*
-//* Maybe we could try to make use of that, it could reduce loc.
+//* Since 0.3.26 the link factory can also make links between nodes and ports by name. We still link by id: our port
+//* index already resolved the ids, and names are not unique when an application opens multiple streams.
 
 namespace Soundux
 {
@@ -38,6 +38,9 @@ namespace Soundux
             std::uint32_t parentNode = 0;
         };
 
+        //* Port ids by direction and side
+        using PortIndex = std::map<spa_direction, std::map<Side, std::set<std::uint32_t>>>;
+
         struct Node
         {
             std::uint32_t id;
@@ -45,8 +48,10 @@ namespace Soundux
             std::uint32_t pid;
             std::string rawName;
             bool isMonitor = false;
+            bool isSink = false; //* Sinks are output devices, so adding or removing them changes the device list
             std::string applicationBinary;
             std::map<std::uint32_t, Port> ports;
+            PortIndex portIndex;
         };
 
         struct PipeWirePlaybackApp : public PlaybackApp
@@ -55,6 +60,12 @@ namespace Soundux
             std::uint32_t nodeId;
             ~PipeWirePlaybackApp() override = default;
         };
+        struct BoundProxy
+        {
+            pw_proxy *proxy = nullptr;
+            spa_hook listener{};
+        };
+
         struct PipeWireRecordingApp : public RecordingApp
         {
             std::uint32_t pid;
@@ -67,23 +78,54 @@ namespace Soundux
             friend class AudioBackend;
 
           private:
-            pw_core *core;
-            pw_main_loop *loop;
-            pw_context *context;
-            pw_registry *registry;
+            pw_core *core = nullptr;
+            pw_thread_loop *loop = nullptr;
+            pw_context *context = nullptr;
+            pw_registry *registry = nullptr;
             std::uint32_t version = 0;
             std::string defaultMicrophone;
+            //* Only touched on the loop thread or while holding the loop lock
+            std::optional<std::uint32_t> microphoneNode;
+
+            spa_hook coreListener{};
+            pw_core_events coreEvents{};
 
-            spa_hook registryListener;
-            pw_registry_events registryEvents;
+            spa_hook registryListener{};
+            pw_registry_events registryEvents{};
+
+            //* Only touched on the loop thread or while holding the loop lock
+            int pendingSync = 0;
+            bool syncDone = false;
+            std::map<std::uint32_t, std::unique_ptr<BoundProxy>> proxies;
+
+            //* ~= Native output, only created when enabled in the settings =~
+            pw_stream *stream = nullptr;
+            spa_hook streamListener{};
+            std::optional<NativeOutput> nativeOutput;
+            //* Whether the loaded library fills in `pw_buffer::requested`, which older ones don't even have
+            bool hasRequested = false;
+
+            bool createStream();
+            static void onProcess(void *);
 
           private:
             sxl::var_guard<std::map<std::uint32_t, Node>> nodes;
+            //* Node ids by application binary, guarded by the lock of `nodes`
+            std::map<std::string, std::set<std::uint32_t>> binaryNodes;
             sxl::var_guard<std::map<std::uint32_t, Port>> ports;
+            //* Guarded by the lock of `ports`
+            PortIndex ownPorts;
 
             void onNodeInfo(const pw_node_info *);
             void onPortInfo(const pw_port_info *);
             void onCoreInfo(const pw_core_info *);
+            void onMetadataProperty(const char *, const char *);
+
+            //* Written by the loop thread, a value of 0 means unset
+            std::atomic<std::uint32_t> clockRate = 0;
+            std::atomic<std::uint32_t> clockQuantum = 0;
+            std::atomic<std::uint32_t> forcedClockRate = 0;
+            std::atomic<std::uint32_t> forcedClockQuantum = 0;
 
           private:
             std::map<std::string, std::vector<std::uint32_t>> soundInputLinks;
@@ -91,9 +133,12 @@ namespace Soundux
 
           private:
             void sync();
+            void disconnect();
+            void release(std::uint32_t);
             bool createNullSink();
-            bool deleteLink(std::uint32_t);
-            std::optional<int> linkPorts(std::uint32_t, std::uint32_t);
+            void deleteLinks(const std::vector<std::uint32_t> &);
+            std::vector<std::uint32_t> linkPorts(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &);
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> matchPorts(const std::string &, spa_direction);
 
             static void onGlobalRemoved(void *, std::uint32_t);
             static void onGlobalAdded(void *, std::uint32_t, std::uint32_t, const char *, std::uint32_t,
@@ -104,6 +149,7 @@ namespace Soundux
 
           public:
             PipeWire() = default;
+            ~PipeWire() override;
             void destroy() override;
 
             bool useAsDefault() override;
@@ -125,6 +171,9 @@ namespace Soundux
 
             std::vector<std::shared_ptr<PlaybackApp>> getPlaybackApps() override;
             std::vector<std::shared_ptr<RecordingApp>> getRecordingApps() override;
+
+            std::optional<NativeOutput> getNativeOutput() override;
+            std::optional<GraphClock> getGraphClock() override;
         };
     } // namespace Objects
 } // namespace Soundux
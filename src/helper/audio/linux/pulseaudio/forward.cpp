@@ -19,11 +19,19 @@ bool Soundux::PulseApi::setup()
 {
 #if defined(USE_FLATPAK)
 #define load(name) name = reinterpret_cast<decltype(name)>(pa_##name);
-    load(mainloop_new);
-    load(mainloop_iterate);
-    load(mainloop_get_api);
+    load(threaded_mainloop_new);
+    load(threaded_mainloop_free);
+    load(threaded_mainloop_lock);
+    load(threaded_mainloop_wait);
+    load(threaded_mainloop_stop);
+    load(threaded_mainloop_start);
+    load(threaded_mainloop_unlock);
+    load(threaded_mainloop_signal);
+    load(threaded_mainloop_get_api);
     load(context_new);
+    load(context_unref);
     load(context_connect);
+    load(context_disconnect);
     load(context_set_state_callback);
     load(context_load_module);
     load(context_get_module_info_list);
@@ -41,6 +49,27 @@ bool Soundux::PulseApi::setup()
     load(context_unload_module);
     load(context_get_state);
     load(operation_get_state);
+    load(operation_unref);
+    load(operation_set_state_callback);
+    load(context_subscribe);
+    load(context_get_module_info);
+    load(context_get_sink_info_list);
+    load(context_get_sink_input_info);
+    load(context_get_sink_info_by_index);
+    load(context_set_subscribe_callback);
+    load(context_get_source_output_info);
+    load(stream_new);
+    load(stream_peek);
+    load(stream_drop);
+    load(stream_unref);
+    load(stream_write);
+    load(stream_get_state);
+    load(stream_disconnect);
+    load(stream_connect_record);
+    load(stream_set_read_callback);
+    load(stream_connect_playback);
+    load(stream_set_monitor_stream);
+    load(usec_to_bytes);
     return true;
 #else
     auto *libpulse = dlopen("libpulse.so.0", RTLD_LAZY);
@@ -51,11 +80,19 @@ bool Soundux::PulseApi::setup()
 
 #define stringify(what) #what
 #define load(name) loadFunc(libpulse, name, stringify(pa_##name))
-            load(mainloop_new);
-            load(mainloop_iterate);
-            load(mainloop_get_api);
+            load(threaded_mainloop_new);
+            load(threaded_mainloop_free);
+            load(threaded_mainloop_lock);
+            load(threaded_mainloop_wait);
+            load(threaded_mainloop_stop);
+            load(threaded_mainloop_start);
+            load(threaded_mainloop_unlock);
+            load(threaded_mainloop_signal);
+            load(threaded_mainloop_get_api);
             load(context_new);
+            load(context_unref);
             load(context_connect);
+            load(context_disconnect);
             load(context_set_state_callback);
             load(context_load_module);
             load(context_get_module_info_list);
@@ -73,6 +110,27 @@ bool Soundux::PulseApi::setup()
             load(context_unload_module);
             load(context_get_state);
             load(operation_get_state);
+            load(operation_unref);
+            load(operation_set_state_callback);
+            load(context_subscribe);
+            load(context_get_module_info);
+            load(context_get_sink_info_list);
+            load(context_get_sink_input_info);
+            load(context_get_sink_info_by_index);
+            load(context_set_subscribe_callback);
+            load(context_get_source_output_info);
+            load(stream_new);
+            load(stream_peek);
+            load(stream_drop);
+            load(stream_unref);
+            load(stream_write);
+            load(stream_get_state);
+            load(stream_disconnect);
+            load(stream_connect_record);
+            load(stream_set_read_callback);
+            load(stream_connect_playback);
+            load(stream_set_monitor_stream);
+            load(usec_to_bytes);
             return true;
         }
         catch (std::exception &e)
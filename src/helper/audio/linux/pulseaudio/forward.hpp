@@ -14,13 +14,24 @@ namespace Soundux
 #define pulse_forward_decl(function) inline std::add_pointer_t<decltype(pa_##function)> function
 
         pulse_forward_decl(context_new);
-        pulse_forward_decl(mainloop_new);
+        pulse_forward_decl(context_subscribe);
+        pulse_forward_decl(context_unref);
         pulse_forward_decl(proplist_gets);
+        pulse_forward_decl(operation_unref);
         pulse_forward_decl(context_connect);
-        pulse_forward_decl(mainloop_iterate);
-        pulse_forward_decl(mainloop_get_api);
+        pulse_forward_decl(context_disconnect);
         pulse_forward_decl(context_get_state);
         pulse_forward_decl(operation_get_state);
+        pulse_forward_decl(threaded_mainloop_new);
+        pulse_forward_decl(threaded_mainloop_free);
+        pulse_forward_decl(threaded_mainloop_lock);
+        pulse_forward_decl(threaded_mainloop_wait);
+        pulse_forward_decl(threaded_mainloop_stop);
+        pulse_forward_decl(threaded_mainloop_start);
+        pulse_forward_decl(threaded_mainloop_unlock);
+        pulse_forward_decl(threaded_mainloop_signal);
+        pulse_forward_decl(threaded_mainloop_get_api);
+        pulse_forward_decl(operation_set_state_callback);
         pulse_forward_decl(context_load_module);
         pulse_forward_decl(context_unload_module);
         pulse_forward_decl(context_get_server_info);
@@ -34,6 +45,24 @@ namespace Soundux
         pulse_forward_decl(context_move_source_output_by_name);
         pulse_forward_decl(context_get_source_output_info_list);
         pulse_forward_decl(context_move_source_output_by_index);
+        pulse_forward_decl(context_get_module_info);
+        pulse_forward_decl(context_get_sink_info_list);
+        pulse_forward_decl(context_get_sink_input_info);
+        pulse_forward_decl(context_get_sink_info_by_index);
+        pulse_forward_decl(context_set_subscribe_callback);
+        pulse_forward_decl(context_get_source_output_info);
+        pulse_forward_decl(stream_new);
+        pulse_forward_decl(stream_peek);
+        pulse_forward_decl(stream_drop);
+        pulse_forward_decl(stream_unref);
+        pulse_forward_decl(stream_write);
+        pulse_forward_decl(stream_get_state);
+        pulse_forward_decl(stream_disconnect);
+        pulse_forward_decl(stream_connect_record);
+        pulse_forward_decl(stream_set_read_callback);
+        pulse_forward_decl(stream_connect_playback);
+        pulse_forward_decl(stream_set_monitor_stream);
+        pulse_forward_decl(usec_to_bytes);
     } // namespace PulseApi
 } // namespace Soundux
 #endif
\ No newline at end of file
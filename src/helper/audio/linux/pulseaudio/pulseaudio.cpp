@@ -2,61 +2,107 @@
 #include "pulseaudio.hpp"
 #include "forward.hpp"
 #include <core/global/globals.hpp>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <fancy.hpp>
 
 namespace Soundux::Objects
 {
+    //* The mainloop lock is recursive, but waiting on the mainloop only releases it once. So we make sure that every
+    //* thread only ever holds the lock of a mainloop once, no matter how deep it is nested.
+    class MainloopLock
+    {
+        pa_threaded_mainloop *mainloop;
+
+        static std::unordered_map<pa_threaded_mainloop *, std::size_t> &depths()
+        {
+            static thread_local std::unordered_map<pa_threaded_mainloop *, std::size_t> depths;
+            return depths;
+        }
+
+      public:
+        MainloopLock(const MainloopLock &) = delete;
+        MainloopLock &operator=(const MainloopLock &) = delete;
+
+        explicit MainloopLock(pa_threaded_mainloop *mainloop) : mainloop(mainloop)
+        {
+            if (depths()[mainloop]++ == 0)
+            {
+                PulseApi::threaded_mainloop_lock(mainloop);
+            }
+        }
+        ~MainloopLock()
+        {
+            auto depth = depths().find(mainloop);
+            if (--depth->second == 0)
+            {
+                depths().erase(depth);
+                PulseApi::threaded_mainloop_unlock(mainloop);
+            }
+        }
+    };
+
+    static void unref(pa_operation *operation)
+    {
+        if (operation)
+        {
+            PulseApi::operation_unref(operation);
+        }
+    }
+    static std::string getProperty(const pa_proplist *proplist, const char *key)
+    {
+        const auto *value = PulseApi::proplist_gets(proplist, key);
+        return value ? value : "";
+    }
+
+    //* Name of the streams we create for in-process passthrough, they should never show up as applications
+    static constexpr auto captureStreamName = "soundux_passthrough";
+
     bool PulseAudio::setup()
     {
+        TraceScope scope("PulseAudio::setup");
+
         if (!PulseApi::setup())
         {
             return false;
         }
 
-        mainloop = PulseApi::mainloop_new();
-        mainloopApi = PulseApi::mainloop_get_api(mainloop);
+        mainloop = PulseApi::threaded_mainloop_new();
+        mainloopApi = PulseApi::threaded_mainloop_get_api(mainloop);
         context = PulseApi::context_new(mainloopApi, "soundux");
-        PulseApi::context_connect(context, nullptr, pa_context_flags::PA_CONTEXT_NOFLAGS, nullptr);
 
-        auto data = std::make_pair(false, false);
         PulseApi::context_set_state_callback(
             context,
-            [](pa_context *context, void *userData) {
-                auto state = PulseApi::context_get_state(context);
-                auto *data = reinterpret_cast<std::pair<bool, bool> *>(userData);
-
-                if (!data)
-                {
-                    return;
-                }
-
-                if (state == PA_CONTEXT_FAILED)
-                {
-                    Fancy::fancy.logTime().failure() << "Failed to connect to pulseaudio" << std::endl;
-                    data->first = true;
-                    data->second = false;
-                }
-                else if (state == PA_CONTEXT_READY)
-                {
-                    Fancy::fancy.logTime().message() << "PulseAudio is ready!" << std::endl;
-                    data->first = true;
-                    data->second = true;
-                }
+            []([[maybe_unused]] pa_context *context, void *userData) {
+                PulseApi::threaded_mainloop_signal(reinterpret_cast<pa_threaded_mainloop *>(userData), 0);
             },
-            &data);
+            mainloop);
 
-        while (!data.first)
-        {
-            PulseApi::mainloop_iterate(mainloop, true, nullptr);
-        }
+        PulseApi::context_connect(context, nullptr, pa_context_flags::PA_CONTEXT_NOFLAGS, nullptr);
+        PulseApi::threaded_mainloop_start(mainloop);
 
-        if (!data.second)
+        MainloopLock lock(mainloop);
+        while (true)
         {
-            return false;
+            auto state = PulseApi::context_get_state(context);
+            if (state == PA_CONTEXT_READY)
+            {
+                Fancy::fancy.logTime().message() << "PulseAudio is ready!" << std::endl;
+                break;
+            }
+            if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED)
+            {
+                Fancy::fancy.logTime().failure() << "Failed to connect to pulseaudio" << std::endl;
+                return false;
+            }
+
+            PulseApi::threaded_mainloop_wait(mainloop);
         }
 
+        subscribe();
+        populate();
+
         unloadLeftOvers();
         fetchDefaultSource();
 
@@ -64,10 +110,19 @@ namespace Soundux::Objects
     }
     bool PulseAudio::loadModules()
     {
-        auto playbackApps = getPlaybackApps();
-        auto recordingApps = getRecordingApps();
+        TraceScope scope("PulseAudio::loadModules");
 
-        await(PulseApi::context_load_module(
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
+        auto originalPlayback = getPlaybackApps();
+        auto originalRecording = getRecordingApps();
+
+        //* The server handles requests of a connection in order, so the loopbacks will always find the sinks
+        //* they depend on. We submit everything at once and only wait for the whole batch.
+        std::vector<pa_operation *> operations;
+
+        operations.emplace_back(PulseApi::context_load_module(
             context, "module-null-sink",
             "sink_name=soundux_sink rate=44100 sink_properties=device.description=soundux_sink",
             []([[maybe_unused]] pa_context *m, std::uint32_t id, void *userData) {
@@ -82,7 +137,7 @@ namespace Soundux::Objects
             },
             &nullSink));
 
-        await(PulseApi::context_load_module(
+        operations.emplace_back(PulseApi::context_load_module(
             context, "module-loopback",
             ("rate=44100 source=" + defaultSource + " sink=soundux_sink sink_dont_move=true source_dont_move=true")
                 .c_str(),
@@ -98,7 +153,49 @@ namespace Soundux::Objects
             },
             &loopBack));
 
-        await(PulseApi::context_load_module(
+        //* In-process passthrough reads the applications directly, so it does not need the passthrough sink
+        auto inProcessPassthrough = Globals::gSettings.inProcessPassthrough;
+        if (!inProcessPassthrough)
+        {
+            loadPassthroughModules(operations);
+        }
+
+        awaitAll(operations);
+
+        fetchLoopBackSinkId();
+
+        if (!nullSink || !loopBack || !loopBackSink ||
+            (!inProcessPassthrough && (!passthrough || !passthroughSink || !passthroughLoopBack)))
+        {
+            Fancy::fancy.logTime().failure() << "Failed to load all modules, rolling back" << std::endl;
+
+            //* loopBackSink is the sink input of our loopback, it goes away with the module
+            std::vector<pa_operation *> rollback;
+            for (auto *module : {&nullSink, &loopBack, &passthrough, &passthroughSink, &passthroughLoopBack})
+            {
+                if (*module)
+                {
+                    rollback.emplace_back(PulseApi::context_unload_module(context, **module, nullptr, nullptr));
+                    module->reset();
+                }
+            }
+            loopBackSink.reset();
+
+            awaitAll(rollback);
+            return false;
+        }
+
+        //* Moves caused by loading the modules (i.e. switch-on-connect) might not have reached our mirror yet
+        populate();
+
+        fixPlaybackApps(originalPlayback);
+        fixRecordingApps(originalRecording);
+
+        return true;
+    }
+    void PulseAudio::loadPassthroughModules(std::vector<pa_operation *> &operations)
+    {
+        operations.emplace_back(PulseApi::context_load_module(
             context, "module-null-sink",
             "sink_name=soundux_sink_passthrough rate=44100 sink_properties=device.description=soundux_sink_passthrough",
             []([[maybe_unused]] pa_context *m, std::uint32_t id, void *userData) {
@@ -113,7 +210,7 @@ namespace Soundux::Objects
             },
             &passthrough));
 
-        await(PulseApi::context_load_module(
+        operations.emplace_back(PulseApi::context_load_module(
             context, "module-loopback",
             "source=soundux_sink_passthrough.monitor sink=soundux_sink source_dont_move=true",
             []([[maybe_unused]] pa_context *m, std::uint32_t id, void *userData) {
@@ -128,7 +225,7 @@ namespace Soundux::Objects
             },
             &passthroughSink));
 
-        await(PulseApi::context_load_module(
+        operations.emplace_back(PulseApi::context_load_module(
             context, "module-loopback", "source=soundux_sink_passthrough.monitor source_dont_move=true",
             []([[maybe_unused]] pa_context *m, std::uint32_t id, void *userData) {
                 if (static_cast<int>(id) < 0)
@@ -141,50 +238,150 @@ namespace Soundux::Objects
                 }
             },
             &passthroughLoopBack));
+    }
+    void PulseAudio::unloadPassthroughModules()
+    {
+        std::vector<pa_operation *> operations;
+        for (auto *module : {&passthrough, &passthroughSink, &passthroughLoopBack})
+        {
+            if (*module)
+            {
+                operations.emplace_back(PulseApi::context_unload_module(context, **module, nullptr, nullptr));
+                module->reset();
+            }
+        }
 
-        fetchLoopBackSinkId();
+        awaitAll(operations);
+    }
+    bool PulseAudio::updatePassthroughModules()
+    {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
+        //* Whatever is passed through right now was set up the other way
+        stopAllPassthrough();
+        unloadPassthroughModules();
 
-        if (!nullSink || !loopBack || !loopBackSink || !passthrough || !passthroughSink || !passthroughLoopBack)
+        //* Without our sink the modules are loaded by loadModules() later on
+        if (Globals::gSettings.inProcessPassthrough || !nullSink)
         {
-            unloadLeftOvers();
-            return false;
+            return true;
         }
 
-        fixPlaybackApps(playbackApps);
-        fixRecordingApps(recordingApps);
+        std::vector<pa_operation *> operations;
+        loadPassthroughModules(operations);
+        awaitAll(operations);
+
+        if (!passthrough || !passthroughSink || !passthroughLoopBack)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to load passthrough modules, rolling back" << std::endl;
+            unloadPassthroughModules();
+            return false;
+        }
 
         return true;
     }
     void PulseAudio::destroy()
     {
-        revertDefault();
-        stopSoundInput();
-        stopAllPassthrough();
+        {
+            std::lock_guard operationLock(operationMutex);
+            MainloopLock lock(mainloop);
 
-        if (nullSink)
-            await(PulseApi::context_unload_module(context, *nullSink, nullptr, nullptr));
-        if (loopBack)
-            await(PulseApi::context_unload_module(context, *loopBack, nullptr, nullptr));
-        if (loopBackSink)
-            await(PulseApi::context_unload_module(context, *loopBackSink, nullptr, nullptr));
+            revertDefault();
+            stopSoundInput();
+            stopAllPassthrough();
+
+            std::vector<pa_operation *> operations;
+            for (const auto &module :
+                 {nullSink, loopBack, loopBackSink, passthrough, passthroughSink, passthroughLoopBack})
+            {
+                if (module)
+                {
+                    operations.emplace_back(PulseApi::context_unload_module(context, *module, nullptr, nullptr));
+                }
+            }
+
+            awaitAll(operations);
+        }
+
+        disconnect();
+    }
+    PulseAudio::~PulseAudio()
+    {
+        disconnect();
+    }
+    void PulseAudio::disconnect()
+    {
+        if (!mainloop)
+        {
+            return;
+        }
 
-        if (passthrough)
-            await(PulseApi::context_unload_module(context, *passthrough, nullptr, nullptr));
-        if (passthroughSink)
-            await(PulseApi::context_unload_module(context, *passthroughSink, nullptr, nullptr));
-        if (passthroughLoopBack)
-            await(PulseApi::context_unload_module(context, *passthroughLoopBack, nullptr, nullptr));
+        //* Stopping the mainloop must not happen while holding the lock, afterwards we own the context exclusively
+        PulseApi::threaded_mainloop_stop(mainloop);
+
+        for (const auto &[app, captures] : capturedApplications)
+        {
+            for (const auto &capture : captures)
+            {
+                release(capture);
+            }
+        }
+        capturedApplications.clear();
+
+        PulseApi::context_disconnect(context);
+        PulseApi::context_unref(context);
+        PulseApi::threaded_mainloop_free(mainloop);
+
+        context = nullptr;
+        mainloop = nullptr;
+        mainloopApi = nullptr;
     }
     void PulseAudio::await(pa_operation *operation)
     {
-        std::lock_guard lock(operationMutex);
-        while (PulseApi::operation_get_state(operation) != PA_OPERATION_DONE)
+        awaitAll({operation});
+    }
+    void PulseAudio::awaitAll(const std::vector<pa_operation *> &operations)
+    {
+        //* Waiting releases the lock, so the mirror may change in the meantime. Operations that rely on state besides
+        //* the mirror are serialized by the operationMutex.
+        MainloopLock lock(mainloop);
+
+        for (auto *operation : operations)
         {
-            PulseApi::mainloop_iterate(mainloop, true, nullptr);
+            if (!operation)
+            {
+                Fancy::fancy.logTime().warning() << "Failed to submit operation to pulseaudio" << std::endl;
+                continue;
+            }
+
+            PulseApi::operation_set_state_callback(
+                operation,
+                []([[maybe_unused]] pa_operation *operation, void *userData) {
+                    PulseApi::threaded_mainloop_signal(reinterpret_cast<pa_threaded_mainloop *>(userData), 0);
+                },
+                mainloop);
+        }
+
+        for (auto *operation : operations)
+        {
+            if (!operation)
+            {
+                continue;
+            }
+
+            while (PulseApi::operation_get_state(operation) == PA_OPERATION_RUNNING)
+            {
+                PulseApi::threaded_mainloop_wait(mainloop);
+            }
+
+            PulseApi::operation_unref(operation);
         }
     }
     void PulseAudio::fetchDefaultSource()
     {
+        MainloopLock lock(mainloop);
+
         await(PulseApi::context_get_server_info(
             context,
             []([[maybe_unused]] pa_context *context, const pa_server_info *info, void *userData) {
@@ -198,6 +395,8 @@ namespace Soundux::Objects
     }
     void PulseAudio::fetchLoopBackSinkId()
     {
+        MainloopLock lock(mainloop);
+
         auto data = std::make_pair(&loopBackSink, loopBack);
 
         await(PulseApi::context_get_sink_input_info_list(
@@ -214,6 +413,9 @@ namespace Soundux::Objects
     }
     void PulseAudio::unloadLeftOvers()
     {
+        MainloopLock lock(mainloop);
+
+        std::vector<std::uint32_t> leftOvers;
         await(PulseApi::context_get_module_info_list(
             context,
             []([[maybe_unused]] pa_context *ctx, const pa_module_info *info, [[maybe_unused]] int eol, void *userData) {
@@ -221,67 +423,351 @@ namespace Soundux::Objects
                 {
                     if (std::string(info->argument).find("soundux") != std::string::npos)
                     {
-                        auto *thiz = reinterpret_cast<PulseAudio *>(userData);
-                        PulseApi::context_unload_module(thiz->context, info->index, nullptr, nullptr);
-                        Fancy::fancy.logTime().success() << "Unloaded left over module " << info->index << std::endl;
+                        reinterpret_cast<std::vector<std::uint32_t> *>(userData)->emplace_back(info->index);
                     }
                 }
             },
-            this));
+            &leftOvers));
+
+        std::vector<pa_operation *> operations;
+        for (const auto &module : leftOvers)
+        {
+            operations.emplace_back(PulseApi::context_unload_module(context, module, nullptr, nullptr));
+            Fancy::fancy.logTime().success() << "Unloading left over module " << module << std::endl;
+        }
+
+        awaitAll(operations);
     }
-    std::vector<std::shared_ptr<PlaybackApp>> PulseAudio::getPlaybackApps()
+    void PulseAudio::subscribe()
     {
-        std::vector<std::shared_ptr<PlaybackApp>> rtn;
-        await(PulseApi::context_get_sink_input_info_list(
+        MainloopLock lock(mainloop);
+
+        PulseApi::context_set_subscribe_callback(
             context,
-            []([[maybe_unused]] pa_context *ctx, const pa_sink_input_info *info, [[maybe_unused]] int eol,
-               void *userData) {
-                if (info && info->driver && std::strcmp(info->driver, "protocol-native.c") == 0)
-                {
-                    PulsePlaybackApp app;
-
-                    app.id = info->index;
-                    app.sink = info->sink;
-                    app.name = PulseApi::proplist_gets(info->proplist, "application.name");
-                    app.pid = std::stoi(PulseApi::proplist_gets(info->proplist, "application.process.id"));
-                    app.application = PulseApi::proplist_gets(info->proplist, "application.process.binary");
-                    reinterpret_cast<decltype(rtn) *>(userData)->emplace_back(std::make_shared<PulsePlaybackApp>(app));
-                }
+            []([[maybe_unused]] pa_context *ctx, pa_subscription_event_type_t event, std::uint32_t id, void *userData) {
+                reinterpret_cast<PulseAudio *>(userData)->onEvent(event, id);
             },
-            &rtn));
+            this);
 
-        return rtn;
+        auto mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_MODULE | PA_SUBSCRIPTION_MASK_SINK_INPUT |
+                    PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT | PA_SUBSCRIPTION_MASK_SERVER;
+
+        await(PulseApi::context_subscribe(context, static_cast<pa_subscription_mask_t>(mask), nullptr, nullptr));
     }
-    std::vector<std::shared_ptr<RecordingApp>> PulseAudio::getRecordingApps()
+    void PulseAudio::populate()
     {
-        std::vector<std::shared_ptr<RecordingApp>> rtn;
-        await(PulseApi::context_get_source_output_info_list(
-            context,
-            []([[maybe_unused]] pa_context *ctx, const pa_source_output_info *info, [[maybe_unused]] int eol,
-               void *userData) {
-                if (info && info->driver && std::strcmp(info->driver, "protocol-native.c") == 0)
-                {
-                    if (info->resample_method && std::strcmp(info->resample_method, "peaks") == 0)
+        TraceScope scope("PulseAudio::populate");
+
+        MainloopLock lock(mainloop);
+
+        //* The lock is released while we wait, so we fill a new mirror and only swap it in once it is complete
+        PulseMirror populated;
+        pending = &populated;
+
+        awaitAll({
+            PulseApi::context_get_sink_info_list(
+                context,
+                []([[maybe_unused]] pa_context *ctx, const pa_sink_info *info, [[maybe_unused]] int eol,
+                   void *userData) {
+                    if (info)
+                    {
+                        reinterpret_cast<PulseMirror *>(userData)->addSink(*info);
+                    }
+                },
+                &populated),
+            PulseApi::context_get_module_info_list(
+                context,
+                []([[maybe_unused]] pa_context *ctx, const pa_module_info *info, [[maybe_unused]] int eol,
+                   void *userData) {
+                    if (info)
+                    {
+                        reinterpret_cast<PulseMirror *>(userData)->addModule(*info);
+                    }
+                },
+                &populated),
+            PulseApi::context_get_sink_input_info_list(
+                context,
+                []([[maybe_unused]] pa_context *ctx, const pa_sink_input_info *info, [[maybe_unused]] int eol,
+                   void *userData) {
+                    if (info)
+                    {
+                        reinterpret_cast<PulseMirror *>(userData)->addPlaybackApp(*info);
+                    }
+                },
+                &populated),
+            PulseApi::context_get_source_output_info_list(
+                context,
+                []([[maybe_unused]] pa_context *ctx, const pa_source_output_info *info, [[maybe_unused]] int eol,
+                   void *userData) {
+                    if (info)
                     {
-                        return;
+                        reinterpret_cast<PulseMirror *>(userData)->addRecordingApp(*info);
                     }
+                },
+                &populated),
+        });
 
-                    PulseRecordingApp app;
+        pending = nullptr;
+        mirror = std::move(populated);
+    }
+    void PulseAudio::update(const std::function<void(PulseMirror &)> &function)
+    {
+        function(mirror);
+        if (pending)
+        {
+            function(*pending);
+        }
+    }
+    void PulseAudio::onEvent(pa_subscription_event_type_t event, std::uint32_t id)
+    {
+        //* Events are dispatched on the mainloop thread, which already holds the lock
+        auto facility = event & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+        auto removed = (event & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE;
+        auto added = (event & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_NEW;
 
-                    app.id = info->index;
-                    app.source = info->source;
-                    app.name = PulseApi::proplist_gets(info->proplist, "application.name");
-                    app.pid = std::stoi(PulseApi::proplist_gets(info->proplist, "application.process.id"));
-                    app.application = PulseApi::proplist_gets(info->proplist, "application.process.binary");
-                    reinterpret_cast<decltype(rtn) *>(userData)->emplace_back(std::make_shared<PulseRecordingApp>(app));
-                }
-            },
-            &rtn));
+        switch (facility)
+        {
+        case PA_SUBSCRIPTION_EVENT_SINK:
+            if (removed || added)
+            {
+                Globals::gAudio.invalidateDevices();
+            }
+            if (removed)
+            {
+                update([id](PulseMirror &target) { target.sinks.erase(id); });
+                break;
+            }
+            unref(PulseApi::context_get_sink_info_by_index(context, id, onSinkInfo, this));
+            break;
+        case PA_SUBSCRIPTION_EVENT_SERVER:
+            //* The default sink might have changed
+            Globals::gAudio.invalidateDevices();
+            break;
+        case PA_SUBSCRIPTION_EVENT_MODULE:
+            if (removed)
+            {
+                update([id](PulseMirror &target) { target.modules.erase(id); });
+                break;
+            }
+            unref(PulseApi::context_get_module_info(context, id, onModuleInfo, this));
+            break;
+        case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+            if (removed)
+            {
+                update([id](PulseMirror &target) { target.removePlaybackApp(id); });
+                onPlaybackAppRemoved(id);
+                break;
+            }
+            unref(PulseApi::context_get_sink_input_info(context, id, onSinkInputInfo, this));
+            break;
+        case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+            if (removed)
+            {
+                update([id](PulseMirror &target) { target.removeRecordingApp(id); });
+                break;
+            }
+            unref(PulseApi::context_get_source_output_info(context, id, onSourceOutputInfo, this));
+            break;
+        default:
+            break;
+        }
+    }
+    void PulseAudio::onSinkInfo([[maybe_unused]] pa_context *ctx, const pa_sink_info *info, [[maybe_unused]] int eol,
+                                void *userData)
+    {
+        if (info)
+        {
+            reinterpret_cast<PulseAudio *>(userData)->update([info](PulseMirror &target) { target.addSink(*info); });
+        }
+    }
+    void PulseAudio::onModuleInfo([[maybe_unused]] pa_context *ctx, const pa_module_info *info,
+                                  [[maybe_unused]] int eol, void *userData)
+    {
+        if (info)
+        {
+            reinterpret_cast<PulseAudio *>(userData)->update([info](PulseMirror &target) { target.addModule(*info); });
+        }
+    }
+    void PulseAudio::onSinkInputInfo([[maybe_unused]] pa_context *ctx, const pa_sink_input_info *info,
+                                     [[maybe_unused]] int eol, void *userData)
+    {
+        if (info)
+        {
+            auto *thiz = reinterpret_cast<PulseAudio *>(userData);
+            thiz->update([info](PulseMirror &target) { target.addPlaybackApp(*info); });
+            thiz->onPlaybackAppAdded(info->index);
+        }
+    }
+    void PulseAudio::onSourceOutputInfo([[maybe_unused]] pa_context *ctx, const pa_source_output_info *info,
+                                        [[maybe_unused]] int eol, void *userData)
+    {
+        if (info)
+        {
+            reinterpret_cast<PulseAudio *>(userData)->update(
+                [info](PulseMirror &target) { target.addRecordingApp(*info); });
+        }
+    }
+    void PulseMirror::addSink(const pa_sink_info &info)
+    {
+        if (info.name)
+        {
+            sinks.insert_or_assign(info.index, PulseSink{info.name, info.sample_spec, info.channel_map});
+        }
+    }
+    void PulseMirror::addModule(const pa_module_info &info)
+    {
+        PulseModule module;
+        module.id = info.index;
+        module.name = info.name ? info.name : "";
+        module.argument = info.argument ? info.argument : "";
+
+        modules.insert_or_assign(info.index, module);
+    }
+    void PulseMirror::addPlaybackApp(const pa_sink_input_info &info)
+    {
+        removePlaybackApp(info.index);
+
+        if (getProperty(info.proplist, "media.name") == captureStreamName)
+        {
+            return;
+        }
+
+        if (info.driver && std::strcmp(info.driver, "protocol-native.c") == 0)
+        {
+            PulsePlaybackApp app;
+
+            app.id = info.index;
+            app.sink = info.sink;
+            app.name = getProperty(info.proplist, "application.name");
+            app.application = getProperty(info.proplist, "application.process.binary");
+            app.pid = std::strtoul(getProperty(info.proplist, "application.process.id").c_str(), nullptr, 10);
+
+            playbackAppsByBinary[app.application].emplace(app.id);
+            playbackApps.emplace(app.id, app);
+        }
+    }
+    void PulseMirror::addRecordingApp(const pa_source_output_info &info)
+    {
+        removeRecordingApp(info.index);
+
+        if (getProperty(info.proplist, "media.name") == captureStreamName)
+        {
+            return;
+        }
+
+        if (info.driver && std::strcmp(info.driver, "protocol-native.c") == 0)
+        {
+            if (info.resample_method && std::strcmp(info.resample_method, "peaks") == 0)
+            {
+                return;
+            }
+
+            PulseRecordingApp app;
+
+            app.id = info.index;
+            app.source = info.source;
+            app.name = getProperty(info.proplist, "application.name");
+            app.application = getProperty(info.proplist, "application.process.binary");
+            app.pid = std::strtoul(getProperty(info.proplist, "application.process.id").c_str(), nullptr, 10);
+
+            recordingAppsByBinary[app.application].emplace(app.id);
+            recordingApps.emplace(app.id, app);
+        }
+    }
+    void PulseMirror::removePlaybackApp(std::uint32_t id)
+    {
+        auto app = playbackApps.find(id);
+        if (app == playbackApps.end())
+        {
+            return;
+        }
+
+        auto binary = playbackAppsByBinary.find(app->second.application);
+        if (binary != playbackAppsByBinary.end())
+        {
+            binary->second.erase(id);
+            if (binary->second.empty())
+            {
+                playbackAppsByBinary.erase(binary);
+            }
+        }
+
+        playbackApps.erase(app);
+    }
+    void PulseMirror::removeRecordingApp(std::uint32_t id)
+    {
+        auto app = recordingApps.find(id);
+        if (app == recordingApps.end())
+        {
+            return;
+        }
+
+        auto binary = recordingAppsByBinary.find(app->second.application);
+        if (binary != recordingAppsByBinary.end())
+        {
+            binary->second.erase(id);
+            if (binary->second.empty())
+            {
+                recordingAppsByBinary.erase(binary);
+            }
+        }
+
+        recordingApps.erase(app);
+    }
+    std::set<std::uint32_t> PulseAudio::findPlaybackApps(const std::string &application)
+    {
+        MainloopLock lock(mainloop);
+
+        //* We return a copy, the mirror may change as soon as we wait for an operation
+        auto binary = mirror.playbackAppsByBinary.find(application);
+        if (binary != mirror.playbackAppsByBinary.end())
+        {
+            return binary->second;
+        }
+
+        return {};
+    }
+    std::set<std::uint32_t> PulseAudio::findRecordingApps(const std::string &application)
+    {
+        MainloopLock lock(mainloop);
+
+        auto binary = mirror.recordingAppsByBinary.find(application);
+        if (binary != mirror.recordingAppsByBinary.end())
+        {
+            return binary->second;
+        }
+
+        return {};
+    }
+    std::vector<std::shared_ptr<PlaybackApp>> PulseAudio::getPlaybackApps()
+    {
+        MainloopLock lock(mainloop);
+
+        std::vector<std::shared_ptr<PlaybackApp>> rtn;
+        for (const auto &[id, app] : mirror.playbackApps)
+        {
+            rtn.emplace_back(std::make_shared<PulsePlaybackApp>(app));
+        }
+
+        return rtn;
+    }
+    std::vector<std::shared_ptr<RecordingApp>> PulseAudio::getRecordingApps()
+    {
+        MainloopLock lock(mainloop);
+
+        std::vector<std::shared_ptr<RecordingApp>> rtn;
+        for (const auto &[id, app] : mirror.recordingApps)
+        {
+            rtn.emplace_back(std::make_shared<PulseRecordingApp>(app));
+        }
 
         return rtn;
     }
     bool PulseAudio::useAsDefault()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         if (!defaultSource.empty())
         {
             await(PulseApi::context_unload_module(context, *loopBack, nullptr, nullptr));
@@ -328,6 +814,9 @@ namespace Soundux::Objects
     }
     bool PulseAudio::revertDefault()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         if (!defaultSource.empty() && loopBack)
         {
             await(PulseApi::context_unload_module(context, *loopBack, nullptr, nullptr));
@@ -370,7 +859,10 @@ namespace Soundux::Objects
     }
     bool PulseAudio::passthroughFrom(std::shared_ptr<PlaybackApp> app)
     {
-        if (movedPassthroughApplications.count(app->application))
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
+        if (movedPassthroughApplications.count(app->application) || capturedApplications.count(app->application))
         {
             Fancy::fancy.logTime().message()
                 << "Ignoring sound passthrough request because requested app is already moved" << std::endl;
@@ -383,61 +875,242 @@ namespace Soundux::Objects
             return false;
         }
 
-        for (const auto &playbackApp : getPlaybackApps())
+        if (Globals::gSettings.inProcessPassthrough)
         {
-            auto pulsePlayback = std::dynamic_pointer_cast<PulsePlaybackApp>(playbackApp);
+            return capture(app->application);
+        }
 
-            if (playbackApp->application == app->application)
-            {
-                bool success = true;
+        for (const auto &id : findPlaybackApps(app->application))
+        {
+            bool success = true;
 
-                await(PulseApi::context_move_sink_input_by_name(
-                    context, pulsePlayback->id, "soundux_sink_passthrough",
-                    []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
-                        if (!success)
-                        {
-                            *reinterpret_cast<bool *>(userData) = false;
-                        }
-                    },
-                    &success));
+            await(PulseApi::context_move_sink_input_by_name(
+                context, id, "soundux_sink_passthrough",
+                []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
+                    if (!success)
+                    {
+                        *reinterpret_cast<bool *>(userData) = false;
+                    }
+                },
+                &success));
 
-                if (!success)
-                {
-                    Fancy::fancy.logTime().warning()
-                        << "Failed top move " << pulsePlayback->id << " to passthrough" << std::endl;
-                    return false;
-                }
+            if (!success)
+            {
+                Fancy::fancy.logTime().warning() << "Failed top move " << id << " to passthrough" << std::endl;
+                return false;
             }
         }
 
         movedPassthroughApplications.emplace(app->application, std::dynamic_pointer_cast<PulsePlaybackApp>(app)->sink);
         return true;
     }
+    bool PulseAudio::capture(const std::string &app)
+    {
+        std::vector<PulseCapture> captures;
+        for (const auto &id : findPlaybackApps(app))
+        {
+            if (auto capture = captureStream(id); capture)
+            {
+                captures.emplace_back(*capture);
+            }
+        }
+
+        if (captures.empty())
+        {
+            Fancy::fancy.logTime().warning() << "Failed to capture any stream of " << app << std::endl;
+            return false;
+        }
+
+        capturedApplications.emplace(app, std::move(captures));
+        return true;
+    }
+    std::optional<PulseCapture> PulseAudio::captureStream(std::uint32_t id)
+    {
+        //* The stream is recorded from the monitor of the sink it plays on and written straight into our null sink.
+        //* We use the format of that sink, so recording does not resample and the only latency this adds is a single
+        //* fragment of the record stream.
+        auto playbackApp = mirror.playbackApps.find(id);
+        if (playbackApp == mirror.playbackApps.end())
+        {
+            return std::nullopt;
+        }
+
+        auto sink = mirror.sinks.find(playbackApp->second.sink);
+        if (sink == mirror.sinks.end())
+        {
+            return std::nullopt;
+        }
+
+        const auto &spec = sink->second.spec;
+        const auto &channelMap = sink->second.channelMap;
+        auto monitor = sink->second.name + ".monitor";
+        auto fragment = static_cast<std::uint32_t>(PulseApi::usec_to_bytes(10000, &spec));
+
+        pa_buffer_attr recordAttributes{};
+        recordAttributes.maxlength = static_cast<std::uint32_t>(-1);
+        recordAttributes.fragsize = fragment;
+
+        pa_buffer_attr playbackAttributes{};
+        playbackAttributes.maxlength = static_cast<std::uint32_t>(-1);
+        playbackAttributes.tlength = fragment * 2;
+        playbackAttributes.prebuf = static_cast<std::uint32_t>(-1);
+        playbackAttributes.minreq = static_cast<std::uint32_t>(-1);
+
+        PulseCapture capture;
+        capture.id = id;
+        capture.sink = sink->first;
+        capture.record = PulseApi::stream_new(context, captureStreamName, &spec, &channelMap);
+        capture.playback = PulseApi::stream_new(context, captureStreamName, &spec, &channelMap);
+
+        if (!capture.record || !capture.playback)
+        {
+            release(capture);
+            Fancy::fancy.logTime().warning() << "Failed to create capture streams for " << id << std::endl;
+            return std::nullopt;
+        }
+
+        PulseApi::stream_set_monitor_stream(capture.record, id);
+        PulseApi::stream_set_read_callback(capture.record, onCaptureRead, capture.playback);
+
+        auto recordFlags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY | PA_STREAM_DONT_MOVE);
+
+        auto playbackResult = PulseApi::stream_connect_playback(capture.playback, "soundux_sink", &playbackAttributes,
+                                                                PA_STREAM_ADJUST_LATENCY, nullptr, nullptr);
+        auto recordResult =
+            PulseApi::stream_connect_record(capture.record, monitor.c_str(), &recordAttributes, recordFlags);
+
+        if (playbackResult < 0 || recordResult < 0)
+        {
+            release(capture);
+            Fancy::fancy.logTime().warning() << "Failed to capture " << id << " from " << monitor << std::endl;
+            return std::nullopt;
+        }
+
+        return capture;
+    }
+    void PulseAudio::onPlaybackAppAdded(std::uint32_t id)
+    {
+        //* Called on the mainloop thread, captured applications may open new streams at any time
+        auto playbackApp = mirror.playbackApps.find(id);
+        if (playbackApp == mirror.playbackApps.end())
+        {
+            return;
+        }
+
+        auto captured = capturedApplications.find(playbackApp->second.application);
+        if (captured == capturedApplications.end())
+        {
+            return;
+        }
+
+        //* The server kills our monitor stream when the application is moved to another sink, so we capture it again
+        auto &captures = captured->second;
+        auto existing =
+            std::find_if(captures.begin(), captures.end(), [id](const auto &capture) { return capture.id == id; });
+
+        if (existing != captures.end())
+        {
+            if (existing->sink == playbackApp->second.sink)
+            {
+                return;
+            }
+
+            release(*existing);
+            captures.erase(existing);
+        }
+
+        if (auto capture = captureStream(id); capture)
+        {
+            captures.emplace_back(*capture);
+        }
+    }
+    void PulseAudio::onPlaybackAppRemoved(std::uint32_t id)
+    {
+        for (auto &[app, captures] : capturedApplications)
+        {
+            auto capture =
+                std::find_if(captures.begin(), captures.end(), [id](const auto &capture) { return capture.id == id; });
+
+            if (capture != captures.end())
+            {
+                release(*capture);
+                captures.erase(capture);
+                return;
+            }
+        }
+    }
+    void PulseAudio::release(const PulseCapture &capture)
+    {
+        if (capture.record)
+        {
+            PulseApi::stream_set_read_callback(capture.record, nullptr, nullptr);
+            PulseApi::stream_disconnect(capture.record);
+            PulseApi::stream_unref(capture.record);
+        }
+        if (capture.playback)
+        {
+            PulseApi::stream_disconnect(capture.playback);
+            PulseApi::stream_unref(capture.playback);
+        }
+    }
+    void PulseAudio::onCaptureRead(pa_stream *stream, [[maybe_unused]] std::size_t length, void *userData)
+    {
+        auto *playback = reinterpret_cast<pa_stream *>(userData);
+
+        const void *data = nullptr;
+        std::size_t size = 0;
+
+        while (PulseApi::stream_peek(stream, &data, &size) == 0 && size > 0)
+        {
+            //* A null pointer with a size means there is a hole in the buffer, which still has to be dropped
+            if (data && PulseApi::stream_get_state(playback) == PA_STREAM_READY)
+            {
+                PulseApi::stream_write(playback, data, size, nullptr, 0, PA_SEEK_RELATIVE);
+            }
+
+            PulseApi::stream_drop(stream);
+        }
+    }
     bool PulseAudio::stopAllPassthrough()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         bool success = true;
-        for (const auto &[movedAppBinary, originalSource] : movedPassthroughApplications)
+        for (const auto &[movedAppBinary, originalSink] : movedPassthroughApplications)
         {
-            for (const auto &app : getPlaybackApps())
+            if (mirror.sinks.find(originalSink) == mirror.sinks.end())
             {
-                auto pulseApp = std::dynamic_pointer_cast<PulsePlaybackApp>(app);
+                Fancy::fancy.logTime().warning()
+                    << "Original sink of " << movedAppBinary << " does not exist anymore" << std::endl;
+                success = false;
+                continue;
+            }
 
-                if (app->application == movedAppBinary)
-                {
-                    await(PulseApi::context_move_sink_input_by_index(
-                        context, pulseApp->id, originalSource,
-                        []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
-                            if (!success)
-                            {
-                                *reinterpret_cast<bool *>(userData) = false;
-                            }
-                        },
-                        &success));
-                }
+            for (const auto &id : findPlaybackApps(movedAppBinary))
+            {
+                await(PulseApi::context_move_sink_input_by_index(
+                    context, id, originalSink,
+                    []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
+                        if (!success)
+                        {
+                            *reinterpret_cast<bool *>(userData) = false;
+                        }
+                    },
+                    &success));
             }
         }
         movedPassthroughApplications.clear();
 
+        for (const auto &[app, captures] : capturedApplications)
+        {
+            for (const auto &capture : captures)
+            {
+                release(capture);
+            }
+        }
+        capturedApplications.clear();
+
         if (!success)
         {
             Fancy::fancy.logTime().warning() << "Failed to move back one or more applications" << std::endl;
@@ -447,26 +1120,35 @@ namespace Soundux::Objects
     }
     bool PulseAudio::stopPassthrough(const std::string &app)
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
+        if (auto captured = capturedApplications.find(app); captured != capturedApplications.end())
+        {
+            for (const auto &capture : captured->second)
+            {
+                release(capture);
+            }
+
+            capturedApplications.erase(captured);
+            return true;
+        }
+
         if (movedPassthroughApplications.find(app) != movedPassthroughApplications.end())
         {
             bool success = true;
-            auto &originalSource = movedPassthroughApplications.at(app);
-            for (const auto &playbackApp : getPlaybackApps())
+            auto originalSink = movedPassthroughApplications.at(app);
+            for (const auto &id : findPlaybackApps(app))
             {
-                auto pulseApp = std::dynamic_pointer_cast<PulsePlaybackApp>(playbackApp);
-
-                if (playbackApp->application == app)
-                {
-                    await(PulseApi::context_move_sink_input_by_index(
-                        context, pulseApp->id, originalSource,
-                        []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
-                            if (!success)
-                            {
-                                *reinterpret_cast<bool *>(userData) = false;
-                            }
-                        },
-                        &success));
-                }
+                await(PulseApi::context_move_sink_input_by_index(
+                    context, id, originalSink,
+                    []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
+                        if (!success)
+                        {
+                            *reinterpret_cast<bool *>(userData) = false;
+                        }
+                    },
+                    &success));
             }
 
             movedPassthroughApplications.erase(app);
@@ -481,6 +1163,9 @@ namespace Soundux::Objects
     }
     bool PulseAudio::inputSoundTo(std::shared_ptr<RecordingApp> app)
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         if (!app)
         {
             Fancy::fancy.logTime().warning() << "Tried to input sound to non existant app" << std::endl;
@@ -492,28 +1177,23 @@ namespace Soundux::Objects
             return true;
         }
 
-        for (const auto &recordingApp : getRecordingApps())
+        for (const auto &id : findRecordingApps(app->application))
         {
-            auto pulseApp = std::dynamic_pointer_cast<PulseRecordingApp>(recordingApp);
+            bool success = true;
+            await(PulseApi::context_move_source_output_by_name(
+                context, id, "soundux_sink.monitor",
+                []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
+                    if (!success)
+                    {
+                        *reinterpret_cast<bool *>(userData) = false;
+                    }
+                },
+                &success));
 
-            if (pulseApp->application == app->application)
+            if (!success)
             {
-                bool success = true;
-                await(PulseApi::context_move_source_output_by_name(
-                    context, pulseApp->id, "soundux_sink.monitor",
-                    []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
-                        if (!success)
-                        {
-                            *reinterpret_cast<bool *>(userData) = false;
-                        }
-                    },
-                    &success));
-
-                if (!success)
-                {
-                    Fancy::fancy.logTime().warning() << "Failed to move " + pulseApp->application << "(" << pulseApp->id
-                                                     << ") to soundux sink" << std::endl;
-                }
+                Fancy::fancy.logTime().warning()
+                    << "Failed to move " + app->application << "(" << id << ") to soundux sink" << std::endl;
             }
         }
 
@@ -522,31 +1202,30 @@ namespace Soundux::Objects
     }
     bool PulseAudio::stopSoundInput()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         bool success = true;
 
         for (const auto &[movedAppBinary, originalSink] : movedApplications)
         {
-            for (const auto &recordingApp : getRecordingApps())
+            for (const auto &id : findRecordingApps(movedAppBinary))
             {
-                auto pulseApp = std::dynamic_pointer_cast<PulseRecordingApp>(recordingApp);
-                if (pulseApp->application == movedAppBinary)
-                {
-                    await(PulseApi::context_move_source_output_by_index(
-                        context, pulseApp->id, originalSink,
-                        []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
-                            if (!success)
-                            {
-                                *reinterpret_cast<bool *>(userData) = false;
-                            }
-                        },
-                        &success));
+                await(PulseApi::context_move_source_output_by_index(
+                    context, id, originalSink,
+                    []([[maybe_unused]] pa_context *ctx, int success, void *userData) {
+                        if (!success)
+                        {
+                            *reinterpret_cast<bool *>(userData) = false;
+                        }
+                    },
+                    &success));
 
-                    if (!success)
-                    {
-                        Fancy::fancy.logTime().warning() << "Failed to move " << pulseApp->name << "(" << pulseApp->id
-                                                         << ") back to original source" << std::endl;
-                        success = false;
-                    }
+                if (!success)
+                {
+                    Fancy::fancy.logTime().warning()
+                        << "Failed to move " << movedAppBinary << "(" << id << ") back to original source" << std::endl;
+                    success = false;
                 }
             }
         }
@@ -556,24 +1235,24 @@ namespace Soundux::Objects
     }
     std::shared_ptr<PlaybackApp> PulseAudio::getPlaybackApp(const std::string &application)
     {
-        for (auto app : getPlaybackApps())
+        MainloopLock lock(mainloop);
+
+        auto binary = mirror.playbackAppsByBinary.find(application);
+        if (binary != mirror.playbackAppsByBinary.end() && !binary->second.empty())
         {
-            if (app->application == application)
-            {
-                return app;
-            }
+            return std::make_shared<PulsePlaybackApp>(mirror.playbackApps.at(*binary->second.begin()));
         }
 
         return nullptr;
     }
     std::shared_ptr<RecordingApp> PulseAudio::getRecordingApp(const std::string &application)
     {
-        for (auto app : getRecordingApps())
+        MainloopLock lock(mainloop);
+
+        auto binary = mirror.recordingAppsByBinary.find(application);
+        if (binary != mirror.recordingAppsByBinary.end() && !binary->second.empty())
         {
-            if (app->application == application)
-            {
-                return app;
-            }
+            return std::make_shared<PulseRecordingApp>(mirror.recordingApps.at(*binary->second.begin()));
         }
 
         return nullptr;
@@ -581,6 +1260,8 @@ namespace Soundux::Objects
 
     void PulseAudio::fixPlaybackApps(const std::vector<std::shared_ptr<PlaybackApp>> &originalPlayback)
     {
+        MainloopLock lock(mainloop);
+
         for (const auto &playbackApp : getPlaybackApps())
         {
             auto pulsePlaybackApp = std::dynamic_pointer_cast<PulsePlaybackApp>(playbackApp);
@@ -604,6 +1285,8 @@ namespace Soundux::Objects
     }
     void PulseAudio::fixRecordingApps(const std::vector<std::shared_ptr<RecordingApp>> &originalRecording)
     {
+        MainloopLock lock(mainloop);
+
         for (const auto &recordingApp : getRecordingApps())
         {
             auto pulseRecordingApp = std::dynamic_pointer_cast<PulseRecordingApp>(recordingApp);
@@ -627,6 +1310,9 @@ namespace Soundux::Objects
     }
     bool PulseAudio::muteInput(bool state)
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         bool success = false;
 
         await(PulseApi::context_set_sink_input_mute(
@@ -644,55 +1330,57 @@ namespace Soundux::Objects
         return success;
     }
 
-    bool PulseAudio::switchOnConnectPresent()
+    bool PulseAudio::isSwitchOnConnectLoaded()
     {
-        bool isPresent = false;
-        await(PulseApi::context_get_module_info_list(
-            context,
-            []([[maybe_unused]] pa_context *ctx, const pa_module_info *info, [[maybe_unused]] int eol, void *userData) {
-                if (info && info->name)
-                {
-                    if (std::string(info->name).find("switch-on-connect") != std::string::npos)
-                    {
-                        *reinterpret_cast<bool *>(userData) = true;
-                        Fancy::fancy.logTime().warning() << "Switch on connect found: " << info->index << std::endl;
-                    }
-                }
-            },
-            &isPresent));
+        MainloopLock lock(mainloop);
 
-        if (isPresent)
+        bool isPresent = false;
+        for (const auto &[id, module] : mirror.modules)
         {
-            if (Globals::gGui)
+            if (module.name.find("switch-on-connect") != std::string::npos)
             {
-                Globals::gGui->onSwitchOnConnectDetected(true);
+                Fancy::fancy.logTime().warning() << "Switch on connect found: " << id << std::endl;
+                isPresent = true;
             }
         }
 
         return isPresent;
     }
+    bool PulseAudio::switchOnConnectPresent()
+    {
+        auto isPresent = isSwitchOnConnectLoaded();
+        if (isPresent && Globals::gGui)
+        {
+            Globals::gGui->onSwitchOnConnectDetected(true);
+        }
+
+        return isPresent;
+    }
 
     void PulseAudio::unloadSwitchOnConnect()
     {
-        await(PulseApi::context_get_module_info_list(
-            context,
-            []([[maybe_unused]] pa_context *ctx, const pa_module_info *info, [[maybe_unused]] int eol,
-               [[maybe_unused]] void *userData) {
-                if (info && info->name)
-                {
-                    if (std::string(info->name).find("switch-on-connect") != std::string::npos)
-                    {
-                        Fancy::fancy.logTime().message() << "Unloading: " << info->index << std::endl;
-                        PulseApi::context_unload_module(ctx, info->index, nullptr, nullptr);
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
 
-                        if (Globals::gGui)
-                        {
-                            Globals::gGui->onSwitchOnConnectDetected(false);
-                        }
-                    }
-                }
-            },
-            nullptr));
+        std::vector<std::uint32_t> switchOnConnect;
+        for (const auto &[id, module] : mirror.modules)
+        {
+            if (module.name.find("switch-on-connect") != std::string::npos)
+            {
+                switchOnConnect.emplace_back(id);
+            }
+        }
+
+        for (const auto &id : switchOnConnect)
+        {
+            Fancy::fancy.logTime().message() << "Unloading: " << id << std::endl;
+            await(PulseApi::context_unload_module(context, id, nullptr, nullptr));
+        }
+
+        if (!switchOnConnect.empty() && Globals::gGui)
+        {
+            Globals::gGui->onSwitchOnConnectDetected(false);
+        }
     }
     bool PulseAudio::isRunningPipeWire()
     {
@@ -709,6 +1397,9 @@ namespace Soundux::Objects
 
     std::set<std::string> PulseAudio::currentlyInputApps()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         std::set<std::string> rtn;
         for (const auto &[app, original] : movedApplications)
         {
@@ -719,11 +1410,18 @@ namespace Soundux::Objects
     }
     std::set<std::string> PulseAudio::currentlyPassedThrough()
     {
+        std::lock_guard operationLock(operationMutex);
+        MainloopLock lock(mainloop);
+
         std::set<std::string> rtn;
         for (const auto &[app, original] : movedPassthroughApplications)
         {
             rtn.emplace(app);
         }
+        for (const auto &[app, captures] : capturedApplications)
+        {
+            rtn.emplace(app);
+        }
 
         return rtn;
     }
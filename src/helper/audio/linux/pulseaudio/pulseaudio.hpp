@@ -1,9 +1,11 @@
 #if defined(__linux__)
 #include "../backend.hpp"
 #include "forward.hpp"
+#include <functional>
 #include <map>
 #include <mutex>
 #include <optional>
+#include <unordered_map>
 
 namespace Soundux
 {
@@ -27,14 +29,56 @@ namespace Soundux
             ~PulseRecordingApp() override = default;
         };
 
+        struct PulseCapture
+        {
+            std::uint32_t id;   //* The captured sink input
+            std::uint32_t sink; //* The sink whose monitor we record from
+            pa_stream *record = nullptr;
+            pa_stream *playback = nullptr;
+        };
+
+        struct PulseSink
+        {
+            std::string name;
+            pa_sample_spec spec;
+            pa_channel_map channelMap;
+        };
+
+        struct PulseModule
+        {
+            std::uint32_t id;
+            std::string name;
+            std::string argument;
+        };
+
+        //* Mirror of the server state, kept up to date by subscription events
+        struct PulseMirror
+        {
+            std::unordered_map<std::uint32_t, PulseSink> sinks;
+            std::unordered_map<std::uint32_t, PulseModule> modules;
+            std::map<std::uint32_t, PulsePlaybackApp> playbackApps;
+            std::map<std::uint32_t, PulseRecordingApp> recordingApps;
+
+            std::unordered_map<std::string, std::set<std::uint32_t>> playbackAppsByBinary;
+            std::unordered_map<std::string, std::set<std::uint32_t>> recordingAppsByBinary;
+
+            void addSink(const pa_sink_info &);
+            void addModule(const pa_module_info &);
+            void addPlaybackApp(const pa_sink_input_info &);
+            void addRecordingApp(const pa_source_output_info &);
+
+            void removePlaybackApp(std::uint32_t);
+            void removeRecordingApp(std::uint32_t);
+        };
+
         class PulseAudio : public AudioBackend
         {
             friend class AudioBackend;
 
           private:
-            pa_context *context;
-            pa_mainloop *mainloop;
-            pa_mainloop_api *mainloopApi;
+            pa_context *context = nullptr;
+            pa_threaded_mainloop *mainloop = nullptr;
+            pa_mainloop_api *mainloopApi = nullptr;
 
             //* ~= The modules we create =~
             std::optional<std::uint32_t> nullSink;
@@ -49,15 +93,49 @@ namespace Soundux
             std::string serverName;
             std::string defaultSource;
 
+            //* Serializes the public operations, the mainloop lock is released whenever we wait for the server
+            std::recursive_mutex operationMutex;
+
             std::map<std::string, std::uint32_t> movedApplications;
             std::map<std::string, std::uint32_t> movedPassthroughApplications;
 
-            std::mutex operationMutex;
+            //* Used instead of moving the application when passthrough is done in-process. Only touched while holding
+            //* the mainloop lock, as new streams of a captured application are picked up by subscription events.
+            std::map<std::string, std::vector<PulseCapture>> capturedApplications;
+
+            //* Only touched while holding the mainloop lock
+            PulseMirror mirror;
+            //* The mirror that is being filled by populate(), events have to be applied to it as well
+            PulseMirror *pending = nullptr;
 
+            void subscribe();
+            void populate();
+            void onEvent(pa_subscription_event_type_t, std::uint32_t);
+            void update(const std::function<void(PulseMirror &)> &);
+
+            static void onSinkInfo(pa_context *, const pa_sink_info *, int, void *);
+            static void onModuleInfo(pa_context *, const pa_module_info *, int, void *);
+            static void onSinkInputInfo(pa_context *, const pa_sink_input_info *, int, void *);
+            static void onSourceOutputInfo(pa_context *, const pa_source_output_info *, int, void *);
+
+            std::set<std::uint32_t> findPlaybackApps(const std::string &);
+            std::set<std::uint32_t> findRecordingApps(const std::string &);
+
+            void disconnect();
             void unloadLeftOvers();
             void fetchDefaultSource();
             void fetchLoopBackSinkId();
+            void loadPassthroughModules(std::vector<pa_operation *> &);
+            void unloadPassthroughModules();
             void await(pa_operation *);
+            void awaitAll(const std::vector<pa_operation *> &);
+
+            bool capture(const std::string &);
+            std::optional<PulseCapture> captureStream(std::uint32_t);
+            void onPlaybackAppAdded(std::uint32_t);
+            void onPlaybackAppRemoved(std::uint32_t);
+            static void release(const PulseCapture &);
+            static void onCaptureRead(pa_stream *, std::size_t, void *);
 
             void fixPlaybackApps(const std::vector<std::shared_ptr<PlaybackApp>> &);
             void fixRecordingApps(const std::vector<std::shared_ptr<RecordingApp>> &);
@@ -66,8 +144,12 @@ namespace Soundux
             bool setup() override;
 
           public:
+            ~PulseAudio() override;
+
             //! Is not ran by default to avoid problems with switch-on-connect
             bool loadModules();
+            //* The passthrough sink is only needed when passthrough is not done in-process
+            bool updatePassthroughModules();
 
             void destroy() override;
             bool isRunningPipeWire();
@@ -87,6 +169,8 @@ namespace Soundux
             bool inputSoundTo(std::shared_ptr<RecordingApp> app) override;
 
             void unloadSwitchOnConnect();
+            bool isSwitchOnConnectLoaded();
+            //* Same as above, but also tells the ui about it
             bool switchOnConnectPresent();
 
             std::shared_ptr<PlaybackApp> getPlaybackApp(const std::string &application) override;
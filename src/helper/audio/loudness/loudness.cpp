@@ -0,0 +1,397 @@
+#include "loudness.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <core/global/globals.hpp>
+#include <fancy.hpp>
+#include <miniaudio.h>
+#if defined(_WIN32)
+#include <helper/misc/misc.hpp>
+#endif
+
+namespace Soundux::Objects
+{
+#if defined(_WIN32)
+    using Soundux::Helpers::widen;
+#endif
+
+    struct LoudnessFilter
+    {
+        static constexpr double pi = 3.14159265358979323846;
+
+        double b0, b1, b2, a1, a2;
+        double z1 = 0, z2 = 0;
+
+        double process(double x)
+        {
+            auto y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+
+            return y;
+        }
+
+        //* The two stages of the K-weighting filter, coefficients are derived for the given sample rate
+        static LoudnessFilter highShelf(double rate)
+        {
+            const auto K = std::tan(pi * 1681.974450955533 / rate);
+            const auto Q = 0.7071752369554196;
+            const auto Vh = std::pow(10, 3.999843853973347 / 20);
+            const auto Vb = std::pow(Vh, 0.4996667741545416);
+            const auto a0 = 1 + K / Q + K * K;
+
+            return {(Vh + Vb * K / Q + K * K) / a0, 2 * (K * K - Vh) / a0, (Vh - Vb * K / Q + K * K) / a0,
+                    2 * (K * K - 1) / a0, (1 - K / Q + K * K) / a0};
+        }
+        static LoudnessFilter highPass(double rate)
+        {
+            const auto K = std::tan(pi * 38.13547087602444 / rate);
+            const auto Q = 0.5003270373238773;
+            const auto a0 = 1 + K / Q + K * K;
+
+            return {1, -2, 1, 2 * (K * K - 1) / a0, (1 - K / Q + K * K) / a0};
+        }
+    };
+
+    std::optional<LoudnessInfo> Loudness::measure(const std::string &path)
+    {
+        TraceScope scope("Loudness::measure");
+
+        ma_decoder decoder;
+        auto config = ma_decoder_config_init(ma_format_f32, 0, 0);
+#if defined(_WIN32)
+        auto res = ma_decoder_init_file_w(widen(path).c_str(), &config, &decoder);
+#else
+        auto res = ma_decoder_init_file(path.c_str(), &config, &decoder);
+#endif
+
+        if (res != MA_SUCCESS)
+        {
+            Fancy::fancy.logTime().warning() << "Failed to analyze loudness of " << path << ", error: " >> res
+                                             << std::endl;
+            return std::nullopt;
+        }
+
+        const auto channels = static_cast<std::size_t>(decoder.outputChannels);
+        const auto rate = static_cast<double>(decoder.outputSampleRate);
+
+        std::vector<LoudnessFilter> shelves(channels, LoudnessFilter::highShelf(rate));
+        std::vector<LoudnessFilter> highPasses(channels, LoudnessFilter::highPass(rate));
+
+        std::vector<double> weights(channels, 1.0);
+        if (channels == 6)
+        {
+            //* 5.1, the LFE channel is ignored and the surround channels are weighted higher
+            weights[3] = 0;
+            weights[4] = weights[5] = 1.41;
+        }
+
+        //* True peak is estimated by oversampling 4x with a windowed sinc interpolator
+        constexpr std::size_t phases = 4, taps = 12;
+        static const auto interpolator = [] {
+            std::array<double, phases * taps> rtn{};
+            const auto center = static_cast<double>(rtn.size() - 1) / 2;
+
+            for (std::size_t i = 0; rtn.size() > i; i++)
+            {
+                auto x = (static_cast<double>(i) - center) / phases;
+                auto sinc = x == 0 ? 1 : std::sin(LoudnessFilter::pi * x) / (LoudnessFilter::pi * x);
+                auto window =
+                    0.5 - 0.5 * std::cos(2 * LoudnessFilter::pi * static_cast<double>(i) / (rtn.size() - 1));
+
+                rtn[i] = sinc * window;
+            }
+
+            return rtn;
+        }();
+
+        std::vector<std::array<double, taps>> history(channels);
+        std::size_t head = 0;
+        double peak = 0;
+
+        //* Loudness is calculated over 400ms blocks that overlap by 75%, so we keep track of 100ms sub-blocks
+        const auto subBlockSize = std::max<std::uint64_t>(static_cast<std::uint64_t>(rate / 10), 1);
+        std::vector<double> subBlocks;
+        std::uint64_t subBlockFrames = 0;
+        double subBlockEnergy = 0;
+
+        std::vector<float> frames(4096 * channels);
+        while (true)
+        {
+            ma_uint64 readFrames{};
+            ma_decoder_read_pcm_frames(&decoder, frames.data(), 4096, &readFrames);
+
+            if (readFrames == 0)
+            {
+                break;
+            }
+
+            for (std::uint64_t i = 0; readFrames > i; i++)
+            {
+                head = (head + 1) % taps;
+                for (std::size_t c = 0; channels > c; c++)
+                {
+                    auto sample = static_cast<double>(frames[i * channels + c]);
+
+                    auto filtered = highPasses[c].process(shelves[c].process(sample));
+                    subBlockEnergy += weights[c] * filtered * filtered;
+
+                    auto &channelHistory = history[c];
+                    channelHistory[head] = sample;
+
+                    //* None of the phases lands on the original sample, so it has to be accounted for on its own
+                    peak = std::max(peak, std::abs(sample));
+
+                    for (std::size_t p = 0; phases > p; p++)
+                    {
+                        double interpolated = 0;
+                        for (std::size_t k = 0; taps > k; k++)
+                        {
+                            interpolated += interpolator[k * phases + p] * channelHistory[(head + taps - k) % taps];
+                        }
+                        peak = std::max(peak, std::abs(interpolated));
+                    }
+                }
+
+                if (++subBlockFrames == subBlockSize)
+                {
+                    subBlocks.emplace_back(subBlockEnergy / static_cast<double>(subBlockSize));
+                    subBlockFrames = 0;
+                    subBlockEnergy = 0;
+                }
+            }
+        }
+
+        ma_decoder_uninit(&decoder);
+
+        std::vector<double> blocks;
+        for (std::size_t i = 3; subBlocks.size() > i; i++)
+        {
+            blocks.emplace_back((subBlocks[i - 3] + subBlocks[i - 2] + subBlocks[i - 1] + subBlocks[i]) / 4);
+        }
+
+        auto toLoudness = [](double energy) { return -0.691 + 10 * std::log10(energy); };
+        auto gatedMean = [&](double threshold) -> std::optional<double> {
+            double sum = 0;
+            std::size_t count = 0;
+
+            for (const auto &block : blocks)
+            {
+                if (toLoudness(block) > threshold)
+                {
+                    sum += block;
+                    count++;
+                }
+            }
+
+            if (count == 0)
+            {
+                return std::nullopt;
+            }
+
+            return sum / static_cast<double>(count);
+        };
+
+        //* Sounds that are too short or too quiet to be gated are reported at the absolute gate
+        LoudnessInfo rtn;
+        rtn.integrated = -70;
+        rtn.truePeak = peak > 0 ? std::max(20 * std::log10(peak), -120.0) : -120;
+
+        if (auto absolute = gatedMean(-70); absolute)
+        {
+            if (auto relative = gatedMean(toLoudness(*absolute) - 10); relative)
+            {
+                rtn.integrated = toLoudness(*relative);
+            }
+        }
+
+        return rtn;
+    }
+    void Loudness::analyze(const std::vector<Sound> &sounds)
+    {
+        std::vector<Sound> outdated;
+        {
+            auto scopedCache = cache.scoped();
+            auto scopedPending = pending.scoped();
+
+            bool shared = false;
+            std::set<std::uint64_t> pendingContents;
+
+            for (const auto &sound : sounds)
+            {
+                auto entry = scopedCache->find(sound.path);
+                if (entry != scopedCache->end() && entry->second.modifiedDate == sound.modifiedDate)
+                {
+                    if (sound.contentId)
+                    {
+                        contentCache.insert_or_assign(sound.contentId, entry->second);
+                    }
+                    continue;
+                }
+                if (scopedPending->find(sound.path) != scopedPending->end())
+                {
+                    continue;
+                }
+
+                if (sound.contentId)
+                {
+                    if (auto known = contentCache.find(sound.contentId); known != contentCache.end())
+                    {
+                        auto info = known->second;
+                        info.modifiedDate = sound.modifiedDate;
+
+                        scopedCache->insert_or_assign(sound.path, info);
+                        shared = true;
+                        continue;
+                    }
+
+                    //* Another copy of this file is already being analyzed, `getGain` falls back to its result
+                    if (!pendingContents.emplace(sound.contentId).second)
+                    {
+                        continue;
+                    }
+                }
+
+                scopedPending->emplace(sound.path);
+                outdated.emplace_back(sound);
+            }
+
+            if (shared)
+            {
+                Globals::gSaver.markCacheDirty();
+            }
+        }
+
+        if (outdated.empty())
+        {
+            return;
+        }
+
+        Fancy::fancy.logTime().message() << "Analyzing loudness of " << outdated.size() << " sound(s)" << std::endl;
+
+        std::lock_guard lock(poolMutex);
+        if (!pool)
+        {
+            pool = std::make_unique<ThreadPool>();
+        }
+
+        for (const auto &sound : outdated)
+        {
+            pool->push([this, path = sound.path, modifiedDate = sound.modifiedDate, contentId = sound.contentId] {
+                auto info = measure(path);
+                if (info)
+                {
+                    info->modifiedDate = modifiedDate;
+                    {
+                        auto scoped = cache.scoped();
+                        scoped->insert_or_assign(path, *info);
+                        if (contentId)
+                        {
+                            contentCache.insert_or_assign(contentId, *info);
+                        }
+                    }
+                    Globals::gSaver.markCacheDirty();
+                }
+
+                pending->erase(path);
+            });
+        }
+    }
+    std::optional<float> Loudness::getGain(const Sound &sound)
+    {
+        auto scoped = cache.scoped();
+
+        const LoudnessInfo *found = nullptr;
+        if (auto entry = scoped->find(sound.path);
+            entry != scoped->end() && entry->second.modifiedDate == sound.modifiedDate)
+        {
+            found = &entry->second;
+        }
+        else if (auto content = contentCache.find(sound.contentId); sound.contentId && content != contentCache.end())
+        {
+            found = &content->second;
+        }
+
+        if (!found)
+        {
+            return std::nullopt;
+        }
+
+        const auto &info = *found;
+        if (info.integrated <= -70)
+        {
+            return std::nullopt;
+        }
+
+        //* We never boost a sound so far that its true peak would exceed -1 dBTP
+        auto gain = static_cast<double>(Globals::gSettings.targetLoudness) - info.integrated;
+        gain = std::min(gain, -1 - info.truePeak);
+
+        return static_cast<float>(std::pow(10, gain / 20));
+    }
+    std::map<std::string, LoudnessInfo> Loudness::getCache()
+    {
+        return cache.copy();
+    }
+    void Loudness::setCache(const std::map<std::string, LoudnessInfo> &newCache)
+    {
+        auto scoped = cache.scoped();
+        *scoped = newCache;
+    }
+    void Loudness::prune(const std::vector<Tab> &tabs)
+    {
+        std::set<std::string> paths;
+        std::set<std::uint64_t> contents;
+        for (const auto &tab : tabs)
+        {
+            for (const auto &sound : tab.sounds)
+            {
+                paths.emplace(sound.path);
+                contents.emplace(sound.contentId);
+            }
+        }
+
+        bool pruned = false;
+        {
+            auto scoped = cache.scoped();
+            for (auto entry = scoped->begin(); entry != scoped->end();)
+            {
+                if (!paths.count(entry->first))
+                {
+                    entry = scoped->erase(entry);
+                    pruned = true;
+                    continue;
+                }
+                ++entry;
+            }
+
+            for (auto entry = contentCache.begin(); entry != contentCache.end();)
+            {
+                if (!contents.count(entry->first))
+                {
+                    entry = contentCache.erase(entry);
+                    continue;
+                }
+                ++entry;
+            }
+        }
+
+        if (pruned)
+        {
+            Globals::gSaver.markCacheDirty();
+        }
+    }
+    void Loudness::forget(const std::string &path)
+    {
+        if (cache->erase(path))
+        {
+            Globals::gSaver.markCacheDirty();
+        }
+    }
+    void Loudness::destroy()
+    {
+        //* Pending analyses are dropped, they will simply be picked up again on the next start
+        std::lock_guard lock(poolMutex);
+        pool.reset();
+    }
+} // namespace Soundux::Objects
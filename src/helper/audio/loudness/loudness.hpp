@@ -0,0 +1,45 @@
+#pragma once
+#include <core/objects/objects.hpp>
+#include <helper/threadpool/threadpool.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <var_guard.hpp>
+#include <vector>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        class Loudness
+        {
+            std::mutex poolMutex;
+            std::unique_ptr<ThreadPool> pool;
+
+            sxl::var_guard<std::set<std::string>> pending;
+            sxl::var_guard<std::map<std::string, LoudnessInfo>> cache;
+            //* Content id -> loudness, so copies of a file share one analysis. Guarded by the lock of `cache`
+            std::unordered_map<std::uint64_t, LoudnessInfo> contentCache;
+
+          public:
+            //* Measures integrated loudness and true peak as described in EBU R128 / ITU-R BS.1770
+            static std::optional<LoudnessInfo> measure(const std::string &);
+
+            void analyze(const std::vector<Sound> &);
+            std::optional<float> getGain(const Sound &);
+
+            std::map<std::string, LoudnessInfo> getCache();
+            void setCache(const std::map<std::string, LoudnessInfo> &);
+
+            //* Drops everything that does not belong to a sound of the given tabs
+            void prune(const std::vector<Tab> &);
+            void forget(const std::string &);
+
+            void destroy();
+        };
+    } // namespace Objects
+} // namespace Soundux
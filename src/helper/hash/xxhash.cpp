@@ -0,0 +1,170 @@
+#include "xxhash.hpp"
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <helper/misc/misc.hpp>
+#endif
+
+namespace Soundux::Objects
+{
+    static constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    static constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+    static constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+    static std::uint64_t rotate(std::uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+    //* Both platforms we build for are little endian, which is what XXH64 expects
+    static std::uint64_t read64(const unsigned char *data)
+    {
+        std::uint64_t rtn = 0;
+        std::memcpy(&rtn, data, sizeof(rtn));
+        return rtn;
+    }
+    static std::uint32_t read32(const unsigned char *data)
+    {
+        std::uint32_t rtn = 0;
+        std::memcpy(&rtn, data, sizeof(rtn));
+        return rtn;
+    }
+    static std::uint64_t mixLane(std::uint64_t lane, std::uint64_t input)
+    {
+        lane += input * prime2;
+        lane = rotate(lane, 31);
+        return lane * prime1;
+    }
+    static std::uint64_t merge(std::uint64_t hash, std::uint64_t lane)
+    {
+        hash ^= mixLane(0, lane);
+        return hash * prime1 + prime4;
+    }
+
+    XXHash64::XXHash64(std::uint64_t seed) : seed(seed)
+    {
+        lanes = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+    }
+    void XXHash64::update(const void *data, std::size_t size)
+    {
+        const auto *input = reinterpret_cast<const unsigned char *>(data);
+        length += size;
+
+        if (buffered + size < buffer.size())
+        {
+            std::memcpy(buffer.data() + buffered, input, size);
+            buffered += size;
+            return;
+        }
+
+        if (buffered > 0)
+        {
+            auto missing = buffer.size() - buffered;
+            std::memcpy(buffer.data() + buffered, input, missing);
+            input += missing;
+            size -= missing;
+
+            for (std::size_t i = 0; lanes.size() > i; i++)
+            {
+                lanes[i] = mixLane(lanes[i], read64(buffer.data() + i * 8));
+            }
+            buffered = 0;
+        }
+
+        while (size >= buffer.size())
+        {
+            for (std::size_t i = 0; lanes.size() > i; i++)
+            {
+                lanes[i] = mixLane(lanes[i], read64(input + i * 8));
+            }
+            input += buffer.size();
+            size -= buffer.size();
+        }
+
+        std::memcpy(buffer.data(), input, size);
+        buffered = size;
+    }
+    std::uint64_t XXHash64::digest() const
+    {
+        std::uint64_t hash = 0;
+        if (length >= buffer.size())
+        {
+            hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+            for (const auto &lane : lanes)
+            {
+                hash = merge(hash, lane);
+            }
+        }
+        else
+        {
+            hash = seed + prime5;
+        }
+
+        hash += length;
+
+        const auto *remaining = buffer.data();
+        const auto *end = buffer.data() + buffered;
+
+        for (; remaining + 8 <= end; remaining += 8)
+        {
+            hash ^= mixLane(0, read64(remaining));
+            hash = rotate(hash, 27) * prime1 + prime4;
+        }
+        if (remaining + 4 <= end)
+        {
+            hash ^= static_cast<std::uint64_t>(read32(remaining)) * prime1;
+            hash = rotate(hash, 23) * prime2 + prime3;
+            remaining += 4;
+        }
+        for (; remaining < end; remaining++)
+        {
+            hash ^= *remaining * prime5;
+            hash = rotate(hash, 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+    std::uint64_t XXHash64::hash(const void *data, std::size_t size, std::uint64_t seed)
+    {
+        XXHash64 state(seed);
+        state.update(data, size);
+        return state.digest();
+    }
+    std::optional<std::uint64_t> XXHash64::hashFile(const std::string &path)
+    {
+#if defined(_WIN32)
+        std::ifstream file(Helpers::widen(path), std::ios::binary);
+#else
+        std::ifstream file(path, std::ios::binary);
+#endif
+        if (!file)
+        {
+            return std::nullopt;
+        }
+
+        XXHash64 state;
+        std::vector<char> chunk(1 << 16);
+
+        while (file)
+        {
+            file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            state.update(chunk.data(), static_cast<std::size_t>(file.gcount()));
+        }
+
+        if (file.bad())
+        {
+            return std::nullopt;
+        }
+
+        return state.digest();
+    }
+} // namespace Soundux::Objects
@@ -0,0 +1,31 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        //* Streaming implementation of XXH64, a fast non-cryptographic hash
+        class XXHash64
+        {
+            std::array<std::uint64_t, 4> lanes{};
+            std::array<unsigned char, 32> buffer{};
+            std::size_t buffered = 0;
+            std::uint64_t length = 0;
+            std::uint64_t seed;
+
+          public:
+            XXHash64(std::uint64_t = 0);
+
+            void update(const void *, std::size_t);
+            std::uint64_t digest() const;
+
+            static std::uint64_t hash(const void *, std::size_t, std::uint64_t = 0);
+            static std::optional<std::uint64_t> hashFile(const std::string &);
+        };
+    } // namespace Objects
+} // namespace Soundux
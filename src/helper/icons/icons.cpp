@@ -5,6 +5,7 @@
 #include <filesystem>
 #include <fstream>
 #include <helper/base64/base64.hpp>
+#include <helper/trace/trace.hpp>
 #include <optional>
 #include <regex>
 
@@ -31,6 +32,8 @@ namespace Soundux::Objects
     }
     std::shared_ptr<IconFetcher> IconFetcher::createInstance()
     {
+        TraceScope scope("IconFetcher::createInstance");
+
         auto instance = std::shared_ptr<IconFetcher>(new IconFetcher()); // NOLINT
 
         if (instance->setup())
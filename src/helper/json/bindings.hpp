@@ -107,7 +107,8 @@ namespace nlohmann
                 {"sound", obj.sound},           {"id", obj.id},
                 {"length", obj.length},         {"paused", obj.paused.load()},
                 {"lengthInMs", obj.lengthInMs}, {"repeat", obj.repeat.load()},
-                {"readFrames", obj.readFrames}, {"readInMs", obj.readInMs.load()},
+                {"readFrames", obj.readFrames.load()}, {"readInMs", obj.readInMs.load()},
+                {"retriggered", obj.retriggered},
             };
         }
         static void from_json(const json &j, Soundux::Objects::PlayingSound &obj)
@@ -115,7 +116,7 @@ namespace nlohmann
             j.at("id").get_to(obj.id);
             j.at("sound").get_to(obj.sound);
             j.at("length").get_to(obj.length);
-            j.at("readFrames").get_to(obj.readFrames);
+            obj.readFrames.store(j.at("readFrames").get<std::uint64_t>());
             j.at("lengthInMs").get_to(obj.lengthInMs);
 
             obj.paused.store(j.at("paused").get<bool>());
@@ -123,6 +124,22 @@ namespace nlohmann
             obj.readInMs.store(j.at("readInMs").get<std::uint64_t>());
         }
     };
+    template <> struct adl_serializer<Soundux::Objects::DeviceStatsSummary>
+    {
+        static void to_json(json &j, const Soundux::Objects::DeviceStatsSummary &obj)
+        {
+            j = {
+                {"device", obj.device},
+                {"callbacks", obj.callbacks},
+                {"readStalls", obj.readStalls},
+                {"minCallbackTime", obj.minCallbackTime},
+                {"maxCallbackTime", obj.maxCallbackTime},
+                {"framesRequested", obj.framesRequested},
+                {"framesDelivered", obj.framesDelivered},
+                {"averageCallbackTime", obj.averageCallbackTime},
+            };
+        }
+    };
     template <> struct adl_serializer<Soundux::Objects::Settings>
     {
         static void to_json(json &j, const Soundux::Objects::Settings &obj)
@@ -132,9 +149,15 @@ namespace nlohmann
                 {"outputs", obj.outputs},
                 {"viewMode", obj.viewMode},
                 {"language", obj.language},
+                {"latencyMode", obj.latencyMode},
                 {"stopHotkey", obj.stopHotkey},
                 {"syncVolumes", obj.syncVolumes},
+                {"targetLoudness", obj.targetLoudness},
+                {"normalizeLoudness", obj.normalizeLoudness},
                 {"selectedTab", obj.selectedTab},
+                {"decodeAhead", obj.decodeAhead},
+                {"maxVoices", obj.maxVoices},
+                {"maxScanDepth", obj.maxScanDepth},
                 {"localVolume", obj.localVolume},
                 {"remoteVolume", obj.remoteVolume},
                 {"audioBackend", obj.audioBackend},
@@ -143,6 +166,12 @@ namespace nlohmann
                 {"tabHotkeysOnly", obj.tabHotkeysOnly},
                 {"minimizeToTray", obj.minimizeToTray},
                 {"allowOverlapping", obj.allowOverlapping},
+                {"stealingPolicy", obj.stealingPolicy},
+                {"restartOnRetrigger", obj.restartOnRetrigger},
+                {"nativeOutput", obj.nativeOutput},
+                {"inProcessPassthrough", obj.inProcessPassthrough},
+                {"binaryLibrary", obj.binaryLibrary},
+                {"recursiveTabs", obj.recursiveTabs},
                 {"muteDuringPlayback", obj.muteDuringPlayback},
                 {"useAsDefaultDevice", obj.useAsDefaultDevice},
                 {"allowMultipleOutputs", obj.allowMultipleOutputs},
@@ -180,9 +209,15 @@ namespace nlohmann
             get_to_safe(j, "language", obj.language);
             get_to_safe(j, "viewMode", obj.viewMode);
             get_to_safe(j, "stopHotkey", obj.stopHotkey);
+            get_to_safe(j, "latencyMode", obj.latencyMode);
             get_to_safe(j, "localVolume", obj.localVolume);
             get_to_safe(j, "selectedTab", obj.selectedTab);
+            get_to_safe(j, "decodeAhead", obj.decodeAhead);
+            get_to_safe(j, "maxVoices", obj.maxVoices);
+            get_to_safe(j, "maxScanDepth", obj.maxScanDepth);
             get_to_safe(j, "syncVolumes", obj.syncVolumes);
+            get_to_safe(j, "targetLoudness", obj.targetLoudness);
+            get_to_safe(j, "normalizeLoudness", obj.normalizeLoudness);
             get_to_safe(j, "audioBackend", obj.audioBackend);
             get_to_safe(j, "remoteVolume", obj.remoteVolume);
             get_to_safe(j, "deleteToTrash", obj.deleteToTrash);
@@ -190,6 +225,12 @@ namespace nlohmann
             get_to_safe(j, "minimizeToTray", obj.minimizeToTray);
             get_to_safe(j, "tabHotkeysOnly", obj.tabHotkeysOnly);
             get_to_safe(j, "allowOverlapping", obj.allowOverlapping);
+            get_to_safe(j, "stealingPolicy", obj.stealingPolicy);
+            get_to_safe(j, "restartOnRetrigger", obj.restartOnRetrigger);
+            get_to_safe(j, "nativeOutput", obj.nativeOutput);
+            get_to_safe(j, "inProcessPassthrough", obj.inProcessPassthrough);
+            get_to_safe(j, "binaryLibrary", obj.binaryLibrary);
+            get_to_safe(j, "recursiveTabs", obj.recursiveTabs);
             get_to_safe(j, "useAsDefaultDevice", obj.useAsDefaultDevice);
             get_to_safe(j, "muteDuringPlayback", obj.muteDuringPlayback);
             get_to_safe(j, "allowMultipleOutputs", obj.allowMultipleOutputs);
@@ -235,16 +276,117 @@ namespace nlohmann
             j.at("tabs").get_to(obj.tabs);
         }
     };
+    template <> struct adl_serializer<Soundux::Objects::LoudnessInfo>
+    {
+        static void to_json(json &j, const Soundux::Objects::LoudnessInfo &obj)
+        {
+            j = {{"modifiedDate", obj.modifiedDate}, {"integrated", obj.integrated}, {"truePeak", obj.truePeak}};
+        }
+        static void from_json(const json &j, Soundux::Objects::LoudnessInfo &obj)
+        {
+            j.at("modifiedDate").get_to(obj.modifiedDate);
+            j.at("integrated").get_to(obj.integrated);
+            j.at("truePeak").get_to(obj.truePeak);
+        }
+    };
+    template <> struct adl_serializer<Soundux::Objects::HotkeyUpdate>
+    {
+        static void to_json(json &j, const Soundux::Objects::HotkeyUpdate &obj)
+        {
+            j = {{"id", obj.id}, {"hotkeys", obj.hotkeys}};
+        }
+        static void from_json(const json &j, Soundux::Objects::HotkeyUpdate &obj)
+        {
+            j.at("id").get_to(obj.id);
+            j.at("hotkeys").get_to(obj.hotkeys);
+        }
+    };
+    template <> struct adl_serializer<Soundux::Objects::VolumeUpdate>
+    {
+        static void to_json(json &j, const Soundux::Objects::VolumeUpdate &obj)
+        {
+            j = {{"id", obj.id}, {"volume", obj.volume}};
+        }
+        static void from_json(const json &j, Soundux::Objects::VolumeUpdate &obj)
+        {
+            j.at("id").get_to(obj.id);
+
+            obj.volume.reset();
+            if (j.find("volume") != j.end() && j.at("volume").is_number())
+            {
+                obj.volume = j.at("volume").get<int>();
+            }
+        }
+    };
+    template <> struct adl_serializer<Soundux::Objects::ScanEntry>
+    {
+        static void to_json(json &j, const Soundux::Objects::ScanEntry &obj)
+        {
+            j = {{"path", obj.path},
+                 {"inode", obj.inode},
+                 {"size", obj.size},
+                 {"modifiedDate", obj.modifiedDate},
+                 {"contentHash", obj.contentHash}};
+        }
+        static void from_json(const json &j, Soundux::Objects::ScanEntry &obj)
+        {
+            j.at("path").get_to(obj.path);
+            j.at("inode").get_to(obj.inode);
+            j.at("size").get_to(obj.size);
+            j.at("modifiedDate").get_to(obj.modifiedDate);
+
+            if (j.find("contentHash") != j.end())
+            {
+                j.at("contentHash").get_to(obj.contentHash);
+            }
+        }
+    };
+    template <> struct adl_serializer<Soundux::Objects::DirectoryManifest>
+    {
+        static void to_json(json &j, const Soundux::Objects::DirectoryManifest &obj)
+        {
+            j = {{"modifiedDate", obj.modifiedDate}, {"entries", obj.entries}, {"directories", obj.directories}};
+        }
+        static void from_json(const json &j, Soundux::Objects::DirectoryManifest &obj)
+        {
+            j.at("modifiedDate").get_to(obj.modifiedDate);
+            j.at("entries").get_to(obj.entries);
+
+            if (j.find("directories") != j.end())
+            {
+                j.at("directories").get_to(obj.directories);
+            }
+            else
+            {
+                obj.modifiedDate = 0; //* Written before subdirectories were tracked, forces a rescan
+            }
+        }
+    };
     template <> struct adl_serializer<Soundux::Objects::Config>
     {
         static void to_json(json &j, const Soundux::Objects::Config &obj)
         {
-            j = {{"data", obj.data}, {"settings", obj.settings}};
+            j = {{"data", obj.data},
+                 {"settings", obj.settings},
+                 {"loudness", obj.loudness},
+                 {"journalSequence", obj.journalSequence}};
         }
         static void from_json(const json &j, Soundux::Objects::Config &obj)
         {
             j.at("data").get_to(obj.data);
-            j.at("settings").get_to(obj.settings);
+
+            if (j.find("settings") != j.end())
+            {
+                j.at("settings").get_to(obj.settings);
+            }
+            if (j.find("loudness") != j.end())
+            {
+                j.at("loudness").get_to(obj.loudness);
+            }
+            if (j.find("journalSequence") != j.end())
+            {
+                j.at("journalSequence").get_to(obj.journalSequence);
+            }
         }
     };
     template <> struct adl_serializer<Soundux::Objects::VersionStatus>
@@ -16,8 +16,11 @@
 
 #if defined(_WIN32)
 #include <Windows.h>
+#include <io.h>
 #include <shellapi.h>
 #include <stringapiset.h>
+#else
+#include <unistd.h>
 #endif
 
 namespace Soundux
@@ -77,6 +80,51 @@ namespace Soundux
         return out;
     }
 #endif
+    bool Helpers::syncFile(std::FILE *file)
+    {
+        if (std::fflush(file) != 0)
+        {
+            return false;
+        }
+#if defined(_WIN32)
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+    bool Helpers::writeFile(const std::string &path, const std::string &content)
+    {
+        auto temporary = path + ".tmp";
+
+        auto *file = std::fopen(temporary.c_str(), "wb");
+        if (!file)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to open " << temporary << std::endl;
+            return false;
+        }
+
+        auto written = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+        auto synced = syncFile(file);
+        std::fclose(file);
+
+        if (!written || !synced)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to write " << temporary << std::endl;
+            return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+
+        if (ec)
+        {
+            Fancy::fancy.logTime().failure() << "Failed to replace " << path << " error: " << ec.message() << "("
+                                             << ec.value() << ")" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
     bool Helpers::deleteFile(const std::string &path, bool trash)
     {
         if (!trash)
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdio>
 #include <optional>
 #include <string>
 #include <vector>
@@ -12,6 +13,10 @@ namespace Soundux
         std::string narrow(const std::wstring &);
 #endif
         bool deleteFile(const std::string &, bool = true);
+        //* Writes to a temporary file which then replaces the target, so the target is never left half-written
+        bool writeFile(const std::string &, const std::string &);
+        //* Makes sure everything written to the stream actually hit the disk
+        bool syncFile(std::FILE *);
 
         bool run(const std::string &);
         std::pair<std::string, bool> getResultCompact(const std::string &);
@@ -0,0 +1,432 @@
+#include "scanner.hpp"
+#include <algorithm>
+#include <core/global/globals.hpp>
+#include <fancy.hpp>
+#include <filesystem>
+#include <helper/hash/xxhash.hpp>
+#include <helper/misc/misc.hpp>
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#endif
+
+namespace Soundux::Objects
+{
+    static std::filesystem::path toPath(const std::string &path)
+    {
+#if defined(_WIN32)
+        return Helpers::widen(path);
+#else
+        return path;
+#endif
+    }
+    static std::optional<std::uint64_t> getModifiedDate(const std::filesystem::path &path)
+    {
+        std::error_code ec;
+        auto writeTime = std::filesystem::last_write_time(path, ec);
+        if (ec)
+        {
+            return std::nullopt;
+        }
+
+        return writeTime.time_since_epoch().count();
+    }
+
+    std::optional<DirectoryManifest> Scanner::getManifest(const std::string &directory)
+    {
+        auto modifiedDate = getModifiedDate(toPath(directory));
+        if (!modifiedDate)
+        {
+            return std::nullopt;
+        }
+
+        auto scoped = manifests.scoped();
+        if (auto manifest = scoped->find(directory); manifest != scoped->end())
+        {
+            if (manifest->second.modifiedDate == *modifiedDate)
+            {
+                return manifest->second;
+            }
+        }
+
+        return std::nullopt;
+    }
+    DirectoryManifest Scanner::scan(const std::string &directory)
+    {
+        TraceScope scope("Scanner::scan");
+
+        const auto path = toPath(directory);
+        DirectoryManifest rtn;
+
+        //* Taken before walking, so that changes made while we scan cause another scan next time
+        if (auto modifiedDate = getModifiedDate(path); modifiedDate)
+        {
+            rtn.modifiedDate = *modifiedDate;
+        }
+        else
+        {
+            forget(directory);
+            return rtn;
+        }
+
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+        {
+            std::error_code entryEc;
+            if (entry.is_directory(entryEc))
+            {
+                auto subDirectory = entry.path().u8string();
+#if defined(_WIN32)
+                std::transform(subDirectory.begin(), subDirectory.end(), subDirectory.begin(),
+                               [](char c) { return c == '\\' ? '/' : c; });
+#endif
+                rtn.directories.emplace_back(subDirectory);
+                continue;
+            }
+
+            std::filesystem::path file = entry;
+            if (entry.is_symlink(entryEc))
+            {
+                file = std::filesystem::read_symlink(entry, entryEc);
+                if (!entryEc && file.has_relative_path())
+                {
+                    file = std::filesystem::canonical(path / file, entryEc);
+                }
+                if (entryEc)
+                {
+                    Fancy::fancy.logTime().warning() << "Failed to resolve " << entry.path() << std::endl;
+                    continue;
+                }
+            }
+
+            auto extension = file.extension().u8string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](char c) { return std::tolower(c); });
+            if (extension != ".mp3" && extension != ".wav" && extension != ".flac")
+            {
+                continue;
+            }
+
+            ScanEntry scanEntry;
+
+            if (auto modifiedDate = getModifiedDate(file); modifiedDate)
+            {
+                scanEntry.modifiedDate = *modifiedDate;
+            }
+            else
+            {
+                Fancy::fancy.logTime().warning() << "Failed to read lastWriteTime of " << file << std::endl;
+            }
+
+#if defined(__linux__)
+            struct stat info;
+            if (stat(file.c_str(), &info) == 0)
+            {
+                scanEntry.inode = info.st_ino;
+                scanEntry.size = info.st_size;
+            }
+#else
+            std::error_code sizeEc;
+            scanEntry.size = std::filesystem::file_size(file, sizeEc);
+            if (sizeEc)
+            {
+                scanEntry.size = 0;
+            }
+#endif
+
+            scanEntry.path = file.u8string();
+#if defined(_WIN32)
+            std::transform(scanEntry.path.begin(), scanEntry.path.end(), scanEntry.path.begin(),
+                           [](char c) { return c == '\\' ? '/' : c; });
+#endif
+
+            rtn.entries.emplace_back(scanEntry);
+        }
+
+        if (ec)
+        {
+            Fancy::fancy.logTime().warning() << "Failed to scan " << directory << ": " << ec.message() << std::endl;
+            forget(directory);
+            return rtn;
+        }
+
+        auto scoped = manifests.scoped();
+        if (auto previous = scoped->find(directory); previous != scoped->end())
+        {
+            std::unordered_map<std::string, const ScanEntry *> previousEntries;
+            for (const auto &entry : previous->second.entries)
+            {
+                previousEntries.emplace(entry.path, &entry);
+            }
+
+            for (auto &entry : rtn.entries)
+            {
+                if (auto known = previousEntries.find(entry.path); known != previousEntries.end())
+                {
+                    const auto &old = *known->second;
+                    if (old.inode == entry.inode && old.size == entry.size && old.modifiedDate == entry.modifiedDate)
+                    {
+                        entry.contentHash = old.contentHash;
+                    }
+                }
+            }
+        }
+
+        scoped->insert_or_assign(directory, rtn);
+        Globals::gSaver.markManifestsDirty();
+
+        return rtn;
+    }
+    std::optional<DirectoryManifest> Scanner::getTree(const std::string &root, std::uint32_t maxDepth)
+    {
+        DirectoryManifest rtn;
+        std::set<std::string> visited;
+        std::vector<std::pair<std::string, std::uint32_t>> directories{{root, 0}};
+
+        while (!directories.empty())
+        {
+            auto [directory, depth] = directories.back();
+            directories.pop_back();
+
+            std::error_code ec;
+            auto canonical = std::filesystem::canonical(toPath(directory), ec);
+            if (ec || !visited.emplace(canonical.u8string()).second)
+            {
+                continue;
+            }
+
+            auto manifest = getManifest(directory);
+            if (!manifest)
+            {
+                return std::nullopt;
+            }
+
+            rtn.entries.insert(rtn.entries.end(), manifest->entries.begin(), manifest->entries.end());
+            if (maxDepth > depth)
+            {
+                for (const auto &subDirectory : manifest->directories)
+                {
+                    directories.emplace_back(subDirectory, depth + 1);
+                }
+            }
+        }
+
+        return rtn;
+    }
+    void Scanner::visit(const std::shared_ptr<TreeScan> &tree, const std::string &directory, std::uint32_t depth)
+    {
+        std::optional<DirectoryManifest> manifest;
+        try
+        {
+            manifest = getManifest(directory);
+            if (!manifest)
+            {
+                manifest = scan(directory);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            Fancy::fancy.logTime().warning() << "Failed to scan " << directory << ": " << e.what() << std::endl;
+        }
+
+        std::vector<std::string> subDirectories;
+        if (manifest && tree->maxDepth > depth)
+        {
+            for (const auto &subDirectory : manifest->directories)
+            {
+                std::error_code ec;
+                auto canonical = std::filesystem::canonical(toPath(subDirectory), ec);
+                if (!ec)
+                {
+                    std::lock_guard lock(tree->mutex);
+                    if (tree->visited.emplace(canonical.u8string()).second)
+                    {
+                        subDirectories.emplace_back(subDirectory);
+                    }
+                }
+            }
+        }
+
+        std::lock_guard lock(tree->mutex);
+        if (manifest && !tree->cancelled)
+        {
+            tree->result.entries.insert(tree->result.entries.end(), manifest->entries.begin(),
+                                        manifest->entries.end());
+
+            if (tree->onDirectory && !tree->onDirectory(tree->result))
+            {
+                tree->cancelled = true;
+            }
+        }
+
+        if (!tree->cancelled)
+        {
+            for (const auto &subDirectory : subDirectories)
+            {
+                tree->pending++;
+                getPool().push([this, tree, subDirectory, depth] { visit(tree, subDirectory, depth + 1); });
+            }
+        }
+
+        if (--tree->pending == 0)
+        {
+            tree->cv.notify_all();
+        }
+    }
+    DirectoryManifest Scanner::scanTree(const std::string &root, std::uint32_t maxDepth,
+                                        const std::function<bool(const DirectoryManifest &)> &onDirectory)
+    {
+        TraceScope scope("Scanner::scanTree");
+
+        auto tree = std::make_shared<TreeScan>();
+        tree->maxDepth = maxDepth;
+        tree->onDirectory = onDirectory;
+
+        std::error_code ec;
+        auto canonical = std::filesystem::canonical(toPath(root), ec);
+        if (ec)
+        {
+            forget(root);
+            return {};
+        }
+        tree->visited.emplace(canonical.u8string());
+
+        tree->pending = 1;
+        getPool().push([this, tree, root] { visit(tree, root, 0); });
+
+        std::unique_lock lock(tree->mutex);
+        tree->cv.wait(lock, [&] { return tree->pending == 0; });
+
+        return std::move(tree->result);
+    }
+    ThreadPool &Scanner::getPool()
+    {
+        std::lock_guard lock(poolMutex);
+        if (!pool)
+        {
+            pool = std::make_unique<ThreadPool>();
+        }
+
+        return *pool;
+    }
+    bool Scanner::hashContents(DirectoryManifest &manifest, const std::atomic<bool> &cancelled)
+    {
+        TraceScope scope("Scanner::hashContents");
+
+        struct Job
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::size_t pending = 0;
+            std::unordered_map<std::string, std::uint64_t> hashes;
+        };
+
+        auto job = std::make_shared<Job>();
+        std::set<std::string> paths;
+        for (const auto &entry : manifest.entries)
+        {
+            if (entry.contentHash == 0)
+            {
+                paths.emplace(entry.path);
+            }
+        }
+
+        if (paths.empty())
+        {
+            return false;
+        }
+
+        {
+            std::lock_guard lock(job->mutex);
+            job->pending = paths.size();
+        }
+
+        for (const auto &path : paths)
+        {
+            getPool().push([job, path, &cancelled] {
+                auto hash = cancelled ? std::nullopt : XXHash64::hashFile(path);
+
+                std::lock_guard lock(job->mutex);
+                if (hash)
+                {
+                    job->hashes.emplace(path, *hash);
+                }
+                if (--job->pending == 0)
+                {
+                    job->cv.notify_all();
+                }
+            });
+        }
+
+        std::unique_lock lock(job->mutex);
+        job->cv.wait(lock, [&] { return job->pending == 0; });
+
+        //* The file might have changed while we were hashing it, so the stored entries only take the hash if they
+        //* still describe the same file as the entry we hashed
+        std::unordered_map<std::string, ScanEntry> hashed;
+        for (auto &entry : manifest.entries)
+        {
+            if (auto hash = job->hashes.find(entry.path); hash != job->hashes.end())
+            {
+                entry.contentHash = hash->second;
+                hashed.emplace(entry.path, entry);
+            }
+        }
+
+        auto scoped = manifests.scoped();
+        for (auto &[directory, stored] : *scoped)
+        {
+            for (auto &entry : stored.entries)
+            {
+                if (auto match = hashed.find(entry.path); match != hashed.end())
+                {
+                    const auto &other = match->second;
+                    if (entry.inode == other.inode && entry.size == other.size &&
+                        entry.modifiedDate == other.modifiedDate)
+                    {
+                        entry.contentHash = other.contentHash;
+                    }
+                }
+            }
+        }
+        Globals::gSaver.markManifestsDirty();
+
+        return !hashed.empty();
+    }
+    void Scanner::forget(const std::string &directory)
+    {
+        auto scoped = manifests.scoped();
+
+        auto removed = scoped->erase(directory);
+        for (auto it = scoped->lower_bound(directory + "/"); it != scoped->end();)
+        {
+            if (it->first.rfind(directory + "/", 0) != 0)
+            {
+                break;
+            }
+
+            it = scoped->erase(it);
+            removed++;
+        }
+
+        if (removed)
+        {
+            Globals::gSaver.markManifestsDirty();
+        }
+    }
+    std::map<std::string, DirectoryManifest> Scanner::getCache()
+    {
+        return manifests.copy();
+    }
+    void Scanner::setCache(const std::map<std::string, DirectoryManifest> &newCache)
+    {
+        auto scoped = manifests.scoped();
+        *scoped = newCache;
+    }
+    void Scanner::destroy()
+    {
+        //* Running tree scans are waiting on the pool, so this may only be called once none are left
+        std::lock_guard lock(poolMutex);
+        pool.reset();
+    }
+} // namespace Soundux::Objects
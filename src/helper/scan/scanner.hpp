@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <core/objects/objects.hpp>
+#include <cstdint>
+#include <functional>
+#include <helper/threadpool/threadpool.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <var_guard.hpp>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        //* Remembers what every tab directory contained when it was last scanned, so that directories which did not
+        //* change since can be served without walking them again
+        class Scanner
+        {
+            sxl::var_guard<std::map<std::string, DirectoryManifest>> manifests;
+
+            std::mutex poolMutex;
+            std::unique_ptr<ThreadPool> pool;
+
+            struct TreeScan
+            {
+                std::uint32_t maxDepth;
+                //* Receives everything found so far and returns whether the scan should go on
+                std::function<bool(const DirectoryManifest &)> onDirectory;
+
+                std::mutex mutex;
+                std::condition_variable cv;
+                std::size_t pending = 0;
+                bool cancelled = false;
+
+                std::set<std::string> visited; //* Canonical paths, so that symlinks can't send us in circles
+                DirectoryManifest result;
+            };
+
+          private:
+            ThreadPool &getPool();
+            void visit(const std::shared_ptr<TreeScan> &, const std::string &, std::uint32_t);
+
+          public:
+            //* Only returns the manifest if the directory did not change since, which costs a single stat
+            std::optional<DirectoryManifest> getManifest(const std::string &);
+            //* Same as above for the directory and all of its subdirectories up to the given depth
+            std::optional<DirectoryManifest> getTree(const std::string &, std::uint32_t);
+
+            //* Walks the directory and replaces its manifest
+            DirectoryManifest scan(const std::string &);
+            //* Walks the directory tree on a thread pool, one task per directory. Unchanged directories are served from
+            //* their manifest. Blocks until the whole tree was visited, so it must not be called from the pool.
+            DirectoryManifest scanTree(const std::string &, std::uint32_t,
+                                       const std::function<bool(const DirectoryManifest &)> & = nullptr);
+
+            //* Hashes the contents of every entry that was not hashed yet in parallel and remembers the results in the
+            //* stored manifests. Entries keep their hash as long as inode, size and modification date stay the same.
+            //* Returns whether anything was hashed, blocks like `scanTree` unless it is cancelled.
+            bool hashContents(DirectoryManifest &, const std::atomic<bool> &);
+
+            //* Drops the manifest of the directory and of all of its subdirectories
+            void forget(const std::string &);
+
+            std::map<std::string, DirectoryManifest> getCache();
+            void setCache(const std::map<std::string, DirectoryManifest> &);
+
+            void destroy();
+        };
+    } // namespace Objects
+} // namespace Soundux
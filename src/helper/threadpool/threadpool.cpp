@@ -0,0 +1,58 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+namespace Soundux::Objects
+{
+    ThreadPool::ThreadPool(std::size_t size)
+    {
+        if (size == 0)
+        {
+            size = std::max<std::size_t>(std::thread::hardware_concurrency(), 2) - 1;
+        }
+
+        for (std::size_t i = 0; size > i; i++)
+        {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(tasksMutex);
+            stop = true;
+        }
+        cv.notify_all();
+
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+    void ThreadPool::work()
+    {
+        std::unique_lock lock(tasksMutex);
+        while (true)
+        {
+            cv.wait(lock, [this] { return !tasks.empty() || stop; });
+            if (stop)
+            {
+                break;
+            }
+
+            auto task = std::move(tasks.front());
+            tasks.pop();
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+    void ThreadPool::push(std::function<void()> task)
+    {
+        {
+            std::lock_guard lock(tasksMutex);
+            tasks.emplace(std::move(task));
+        }
+        cv.notify_one();
+    }
+} // namespace Soundux::Objects
@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        class ThreadPool
+        {
+            std::queue<std::function<void()>> tasks;
+            std::vector<std::thread> workers;
+            std::mutex tasksMutex;
+
+            std::condition_variable cv;
+            std::atomic<bool> stop = false;
+
+          private:
+            void work();
+
+          public:
+            //* Defaults to one thread less than there are cores, so that there is always room left for playback
+            ThreadPool(std::size_t = 0);
+            ~ThreadPool();
+
+            void push(std::function<void()>);
+        };
+    } // namespace Objects
+} // namespace Soundux
@@ -0,0 +1,80 @@
+#include "trace.hpp"
+#include <core/global/globals.hpp>
+#include <fancy.hpp>
+#include <filesystem>
+#include <helper/misc/misc.hpp>
+#include <nlohmann/json.hpp>
+
+namespace Soundux::Objects
+{
+    //* Chrome trace wants small numeric thread ids, so every thread gets the next one the first time it records
+    static std::uint64_t currentThread()
+    {
+        static std::atomic<std::uint64_t> counter = 0;
+        static thread_local auto id = ++counter;
+        return id;
+    }
+
+    void Tracer::enable()
+    {
+        enabled = true;
+    }
+    bool Tracer::isEnabled() const
+    {
+        return enabled;
+    }
+    void Tracer::record(const char *name, std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end)
+    {
+        std::lock_guard lock(eventsMutex);
+        if (enabled)
+        {
+            events.push_back({name, currentThread(), start, end});
+        }
+    }
+    void Tracer::finish()
+    {
+        std::lock_guard lock(eventsMutex);
+        if (!enabled.exchange(false))
+        {
+            return;
+        }
+
+        auto micros = [](std::chrono::steady_clock::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+
+        auto traceEvents = nlohmann::json::array();
+        for (const auto &event : events)
+        {
+            traceEvents.push_back({{"name", event.name},
+                                   {"ph", "X"},
+                                   {"pid", 1},
+                                   {"tid", event.thread},
+                                   {"ts", micros(event.start - origin)},
+                                   {"dur", micros(event.end - event.start)}});
+        }
+        events.clear();
+
+        auto path = (std::filesystem::temp_directory_path() / "soundux-startup-trace.json").u8string();
+        if (Helpers::writeFile(path, nlohmann::json{{"traceEvents", traceEvents}}.dump()))
+        {
+            Fancy::fancy.logTime().success() << "Startup trace written to " << path << std::endl;
+        }
+    }
+
+    TraceScope::TraceScope(const char *name) : name(name)
+    {
+        if (Globals::gTracer.isEnabled())
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    TraceScope::~TraceScope()
+    {
+        if (start)
+        {
+            Globals::gTracer.record(name, *start, std::chrono::steady_clock::now());
+        }
+    }
+} // namespace Soundux::Objects
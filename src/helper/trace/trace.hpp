@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Soundux
+{
+    namespace Objects
+    {
+        class Tracer
+        {
+            struct Event
+            {
+                std::string name;
+                std::uint64_t thread;
+                std::chrono::steady_clock::time_point start;
+                std::chrono::steady_clock::time_point end;
+            };
+
+            std::mutex eventsMutex;
+            std::vector<Event> events;
+
+            std::atomic<bool> enabled = false;
+            const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+          public:
+            void enable();
+            bool isEnabled() const;
+
+            void record(const char *, std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point);
+
+            //* Writes everything recorded so far in the chrome trace format (chrome://tracing, ui.perfetto.dev) and
+            //* stops recording, so scopes cost nothing after startup
+            void finish();
+        };
+
+        //* Records the lifetime of the scope on the current thread, does nothing unless tracing is enabled
+        class TraceScope
+        {
+            const char *name;
+            std::optional<std::chrono::steady_clock::time_point> start;
+
+          public:
+            TraceScope(const TraceScope &) = delete;
+            TraceScope &operator=(const TraceScope &) = delete;
+
+            explicit TraceScope(const char *);
+            ~TraceScope();
+        };
+    } // namespace Objects
+} // namespace Soundux
@@ -9,8 +9,10 @@ namespace Soundux::Objects
     const std::regex YoutubeDl::urlRegex(
         R"(https?:\/\/(www\.)?[-a-zA-Z0-9@:%._\+~#=]{1,256}\.[a-zA-Z0-9()]{1,6}\b([-a-zA-Z0-9()@:%_\+.~#?&\/\/=]*))");
 
-    void YoutubeDl::setup()
+    void YoutubeDl::probe() const
     {
+        TraceScope scope("YoutubeDl::probe");
+
         TinyProcessLib::Process ytdlVersion(
             "youtube-dl --version", "", []([[maybe_unused]] const char *message, [[maybe_unused]] std::size_t size) {},
             []([[maybe_unused]] const char *message, [[maybe_unused]] std::size_t size) {});
@@ -26,7 +28,7 @@ namespace Soundux::Objects
     }
     std::optional<nlohmann::json> YoutubeDl::getInfo(const std::string &url) const
     {
-        if (!isAvailable)
+        if (!available())
         {
             return std::nullopt;
         }
@@ -71,7 +73,7 @@ namespace Soundux::Objects
     }
     bool YoutubeDl::download(const std::string &url)
     {
-        if (!isAvailable)
+        if (!available())
         {
             Globals::gGui->onError(Enums::ErrorCode::YtdlNotFound);
             return false;
@@ -139,6 +141,7 @@ namespace Soundux::Objects
     }
     bool YoutubeDl::available() const
     {
+        std::call_once(probed, [this] { probe(); });
         return isAvailable;
     }
 } // namespace Soundux::Objects
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <json.hpp>
+#include <mutex>
 #include <optional>
 #include <process.hpp>
 #include <regex>
@@ -11,13 +12,16 @@ namespace Soundux
     {
         class YoutubeDl
         {
-            bool isAvailable = false;
+            mutable bool isAvailable = false;
+            mutable std::once_flag probed;
             static const std::regex urlRegex;
             std::optional<TinyProcessLib::Process> currentDownload;
 
+            void probe() const;
+
           public:
-            void setup();
             void killDownload();
+            //* The version probes only run on first use, nothing at startup depends on them
             bool available() const;
             bool download(const std::string &);
             std::optional<nlohmann::json> getInfo(const std::string &) const;
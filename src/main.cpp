@@ -2,6 +2,7 @@
 #include <core/enums/enums.hpp>
 #include <core/global/globals.hpp>
 #include <fancy.hpp>
+#include <future>
 #include <ui/impl/webview/webview.hpp>
 
 #if defined(__linux__)
@@ -54,6 +55,11 @@ int main(int argc, char **arguments)
     {
         Fancy::fancy.logTime().success() << "Enabling debug features" << std::endl;
     }
+    if (std::getenv("SOUNDUX_DEBUG") != nullptr || // NOLINT
+        std::find(args.begin(), args.end(), "--trace-startup") != args.end())
+    {
+        gTracer.enable();
+    }
 
     backward::SignalHandling crashHandler;
     gGuard = std::make_shared<guardpp::guard>("soundux-guard");
@@ -65,6 +71,8 @@ int main(int argc, char **arguments)
         Fancy::fancy.message() << "  -h --help        description of launch arguments" << std::endl;
         Fancy::fancy.message() << "  --hidden         start application hidden to taskbar" << std::endl;
         Fancy::fancy.message() << "  --reset-mutex    fix 'Another instance is already running! error'" << std::endl;
+        Fancy::fancy.message() << "  --trace-startup  write a chrome trace of the startup to the temp directory"
+                               << std::endl;
         return 0;
     }
 
@@ -87,29 +95,42 @@ int main(int argc, char **arguments)
     }
 
     gConfig.load();
+    gJournal.replay(gConfig);
     gData.set(gConfig.data);
     gSettings = gConfig.settings;
-
+    gLoudness.setCache(gConfig.loudness);
+    gScanner.setCache(gConfig.manifests);
+    gJournal.setup();
+
+    //* Connecting to the sound server and enumerating devices does not need the window, so it runs while the webview
+    //* is set up and shown. The icon fetcher and the youtube-dl probe are created on first use.
+    //* It neither writes the settings nor talks to the ui, the window picks up the backend once it needs audio.
+    //* Whether switch-on-connect was found is reported to the ui once the page loaded.
+    auto audioSetup = std::async(std::launch::async, [backend = gSettings.audioBackend]() mutable {
 #if defined(__linux__)
-    gIcons = IconFetcher::createInstance();
-    gAudioBackend = AudioBackend::createInstance(gSettings.audioBackend);
+        gAudioBackend = AudioBackend::createInstance(backend);
 #elif defined(_WIN32)
-    gWinSound = WinSound::createInstance();
+        gWinSound = WinSound::createInstance();
 #endif
 
-    gAudio.setup();
-    gYtdl.setup();
+        gAudio.setup();
 
 #if defined(__linux__)
-    if (gAudioBackend && gSettings.audioBackend == BackendType::PulseAudio && gConfig.settings.useAsDefaultDevice)
-    {
-        gAudioBackend->useAsDefault();
-    }
+        if (gAudioBackend && backend == BackendType::PulseAudio && gSettings.useAsDefaultDevice)
+        {
+            gAudioBackend->useAsDefault();
+        }
 #endif
+        return backend;
+    });
 
     gGui = std::make_unique<Soundux::Objects::WebView>();
+    gGui->setAudioSetup(audioSetup.share());
     gGui->setup();
 
+    //* Playing and stopping sounds waits for the audio, so the hotkeys can be listened to right away
+    gHotKeys.init();
+
     if (std::find(args.begin(), args.end(), "--hidden") == args.end())
     {
         gGui->show();
@@ -126,17 +147,32 @@ int main(int argc, char **arguments)
 #endif
 
     gGui->mainLoop();
+    gGui->awaitAudio();
 
     gAudio.destroy();
+    gLoudness.destroy();
+    gScanner.destroy();
 #if defined(__linux__)
     if (gAudioBackend)
     {
         gAudioBackend->destroy();
     }
 #endif
-    gConfig.data.set(gData);
+    gSaver.destroy();
+    gJournal.destroy();
+    {
+        auto lock = gData.lock();
+        gConfig.data.set(gData);
+        gConfig.journalSequence = gJournal.getSequence();
+    }
     gConfig.settings = gSettings;
-    gConfig.save();
+    gConfig.loudness = gLoudness.getCache();
+    gConfig.manifests = gScanner.getCache();
+
+    if (gConfig.save())
+    {
+        gJournal.clear();
+    }
 
     return 0;
 }
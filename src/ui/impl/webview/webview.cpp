@@ -21,6 +21,8 @@ namespace Soundux::Objects
 {
     void WebView::setup()
     {
+        TraceScope scope("WebView::setup");
+
         Window::setup();
 
         webview =
@@ -73,6 +75,8 @@ namespace Soundux::Objects
 #else
         webview->setUrl("file://" + path.string());
 #endif
+
+        startScanner();
     }
     void WebView::show()
     {
@@ -135,11 +139,19 @@ namespace Soundux::Objects
         webview->expose(Webview::Function(
             "moveTabs", [this](const std::vector<int> &newOrder) { return changeTabOrder(newOrder); }));
         webview->expose(Webview::Function("markFavorite", [this](const std::uint32_t &id, bool favorite) {
+            auto lock = Globals::gData.lock();
             Globals::gData.markFavorite(id, favorite);
+            if (auto sound = Globals::gData.getSound(id); sound)
+            {
+                Globals::gJournal.onSoundChanged(*sound);
+            }
             return Globals::gData.getFavoriteIds();
         }));
         webview->expose(Webview::Function("getFavorites", [this] { return Globals::gData.getFavoriteIds(); }));
-        webview->expose(Webview::Function("isYoutubeDLAvailable", []() { return Globals::gYtdl.available(); }));
+        webview->expose(Webview::AsyncFunction("isYoutubeDLAvailable", [](Webview::Promise promise) {
+            //* Probing runs youtube-dl, which can take a while
+            promise.resolve(Globals::gYtdl.available());
+        }));
         webview->expose(
             Webview::AsyncFunction("getYoutubeDLInfo", [this](Webview::Promise promise, const std::string &url) {
                 promise.resolve(Globals::gYtdl.getInfo(url));
@@ -160,6 +172,7 @@ namespace Soundux::Objects
             "updateCheck", [this](Webview::Promise promise) { promise.resolve(VersionCheck::getStatus()); }));
         webview->expose(Webview::Function("isOnFavorites", [this](bool state) { setIsOnFavorites(state); }));
         webview->expose(Webview::Function("deleteSound", [this](std::uint32_t id) { return deleteSound(id); }));
+        webview->expose(Webview::Function("getDuplicates", [this]() { return getDuplicates(); }));
         webview->expose(Webview::Function("setCustomLocalVolume",
                                           [this](const std::uint32_t &id, const std::optional<int> &volume) {
                                               return setCustomLocalVolume(id, volume);
@@ -168,8 +181,24 @@ namespace Soundux::Objects
                                           [this](const std::uint32_t &id, const std::optional<int> &volume) {
                                               return setCustomRemoteVolume(id, volume);
                                           }));
+        webview->expose(Webview::Function(
+            "setHotkeys", [this](const std::vector<HotkeyUpdate> &updates) { return setHotkeys(updates); }));
+        webview->expose(Webview::Function("setCustomLocalVolumes", [this](const std::vector<VolumeUpdate> &updates) {
+            return setCustomLocalVolumes(updates);
+        }));
+        webview->expose(Webview::Function("setCustomRemoteVolumes", [this](const std::vector<VolumeUpdate> &updates) {
+            return setCustomRemoteVolumes(updates);
+        }));
         webview->expose(Webview::Function("toggleSoundPlayback", [this]() { return toggleSoundPlayback(); }));
 
+        if (std::getenv("SOUNDUX_DEBUG") != nullptr) // NOLINT
+        {
+            webview->expose(Webview::Function("getAudioStats", [this]() {
+                awaitAudio();
+                return Globals::gAudio.getDeviceStats();
+            }));
+        }
+
 #if !defined(__linux__)
         webview->expose(Webview::Function("getOutputs", [this]() { return getOutputs(); }));
 #endif
@@ -196,7 +225,8 @@ namespace Soundux::Objects
 
             webview->exit();
         }));
-        webview->expose(Webview::Function("isVBCableProperlySetup", [] {
+        webview->expose(Webview::Function("isVBCableProperlySetup", [this] {
+            awaitAudio();
             if (Globals::gWinSound)
             {
                 return Globals::gWinSound->isVBCableProperlySetup();
@@ -205,7 +235,8 @@ namespace Soundux::Objects
             Fancy::fancy.logTime().failure() << "Windows Sound Backend not found" << std::endl;
             return false;
         }));
-        webview->expose(Webview::Function("setupVBCable", [](const std::string &micOverride) {
+        webview->expose(Webview::Function("setupVBCable", [this](const std::string &micOverride) {
+            awaitAudio();
             if (Globals::gWinSound)
             {
                 return Globals::gWinSound->setupVBCable(Globals::gWinSound->getRecordingDevice(micOverride));
@@ -215,7 +246,8 @@ namespace Soundux::Objects
             return false;
         }));
         webview->expose(Webview::Function(
-            "getRecordingDevices", []() -> std::pair<std::vector<RecordingDevice>, std::optional<RecordingDevice>> {
+            "getRecordingDevices", [this]() -> std::pair<std::vector<RecordingDevice>, std::optional<RecordingDevice>> {
+                awaitAudio();
                 if (Globals::gWinSound)
                 {
                     auto devices = Globals::gWinSound->getRecordingDevices();
@@ -265,7 +297,8 @@ namespace Soundux::Objects
             Webview::Function("startPassthrough", [this](const std::string &app) { return startPassthrough(app); }));
         webview->expose(
             Webview::Function("stopPassthrough", [this](const std::string &name) { stopPassthrough(name); }));
-        webview->expose(Webview::Function("unloadSwitchOnConnect", []() {
+        webview->expose(Webview::Function("unloadSwitchOnConnect", [this]() {
+            awaitAudio();
             auto pulseBackend =
                 std::dynamic_pointer_cast<Soundux::Objects::PulseAudio>(Soundux::Globals::gAudioBackend);
             if (pulseBackend)
@@ -303,6 +336,7 @@ namespace Soundux::Objects
             static bool once = false;
             if (!once)
             {
+                awaitAudio();
 #if defined(__linux__)
                 if (auto pulseBackend = std::dynamic_pointer_cast<PulseAudio>(Globals::gAudioBackend); pulseBackend)
                 {
@@ -340,6 +374,9 @@ namespace Soundux::Objects
                                             .get();
 
                     setupTray();
+
+                    //* The UI is fully up at this point, so this is where startup ends
+                    Globals::gTracer.finish();
                 });
 
                 once = true;
@@ -348,6 +385,8 @@ namespace Soundux::Objects
     }
     void WebView::setupTray()
     {
+        TraceScope scope("WebView::setupTray");
+
         tray->addEntry(Tray::Button(translations.exit, [this]() {
             tray->exit();
             webview->exit();
@@ -381,6 +420,7 @@ namespace Soundux::Objects
     void WebView::mainLoop()
     {
         webview->run();
+        stopScanner();
         if (tray)
         {
             tray->exit();
@@ -433,6 +473,11 @@ namespace Soundux::Objects
         webview->callFunction<void>(
             Webview::JavaScriptFunction("window.getStore().commit", "setSettings", Globals::gSettings));
     }
+    void WebView::onTabsChanged()
+    {
+        webview->callFunction<void>(
+            Webview::JavaScriptFunction("window.getStore().commit", "setTabs", Globals::gData.getTabs()));
+    }
     void WebView::onAllSoundsFinished()
     {
         Window::onAllSoundsFinished();
@@ -32,6 +32,7 @@ namespace Soundux
 
             void onAdminRequired() override;
             void onSettingsChanged() override;
+            void onTabsChanged() override;
             void onSwitchOnConnectDetected(bool state) override;
             void onError(const Enums::ErrorCode &error) override;
             void onSoundPlayed(const PlayingSound &sound) override;
@@ -9,25 +9,194 @@
 #include <helper/misc/misc.hpp>
 #include <nfd.hpp>
 #include <optional>
+#include <unordered_map>
 
 namespace Soundux::Objects
 {
     void Window::setup()
     {
+        TraceScope scope("Window::setup");
+
         NFD::Init();
-        Globals::gHotKeys.init();
         for (auto &tab : Globals::gData.getTabs())
         {
-            tab.sounds = getTabContent(tab);
+            auto manifest = getCachedTabContent(tab);
+            if (!manifest)
+            {
+                //* Keeps its stored sounds until the directory was scanned in the background
+                pendingScans.emplace_back(tab);
+                continue;
+            }
+
+            tab.sounds = buildTabContent(tab, *manifest);
             Globals::gData.setTab(tab.id, tab);
+
+            if (std::any_of(manifest->entries.begin(), manifest->entries.end(),
+                            [](const auto &entry) { return entry.contentHash == 0; }))
+            {
+                //* Analyzed once the contents are hashed, so that copies of the same file are only analyzed once
+                pendingScans.emplace_back(tab);
+                continue;
+            }
+
+            if (Globals::gSettings.normalizeLoudness)
+            {
+                Globals::gLoudness.analyze(tab.sounds);
+            }
         }
+
+        Globals::gLoudness.prune(Globals::gData.getTabs());
     }
     Window::~Window()
     {
+        stopScanner();
         NFD::Quit();
         Globals::gHotKeys.stop();
     }
-    std::vector<Sound> Window::getTabContent(const Tab &tab) const
+    void Window::startScanner()
+    {
+        scanner = std::thread([this] {
+            std::unique_lock lock(scanMutex);
+            while (true)
+            {
+                scanCv.wait(lock, [this] { return !pendingScans.empty() || shouldStopScanning; });
+                if (shouldStopScanning)
+                {
+                    break;
+                }
+
+                auto tab = std::move(pendingScans.front());
+                pendingScans.pop_front();
+
+                lock.unlock();
+                scanInBackground(tab);
+                lock.lock();
+            }
+        });
+    }
+    void Window::stopScanner()
+    {
+        {
+            std::lock_guard lock(scanMutex);
+            shouldStopScanning = true;
+        }
+        scanCv.notify_all();
+
+        if (scanner.joinable())
+        {
+            scanner.join();
+        }
+    }
+    void Window::queueScan(const Tab &tab)
+    {
+        {
+            std::lock_guard lock(scanMutex);
+            pendingScans.emplace_back(tab);
+        }
+        scanCv.notify_one();
+    }
+    void Window::scanInBackground(const Tab &tab)
+    {
+        auto publish = [&](const DirectoryManifest &manifest) { return applyTabContent(tab, manifest); };
+
+        DirectoryManifest manifest;
+        if (auto cached = getCachedTabContent(tab); cached)
+        {
+            //* Only queued to be hashed
+            manifest = std::move(*cached);
+        }
+        else if (Globals::gSettings.recursiveTabs)
+        {
+            //* Large trees take a while, so the ui gets what was found so far every now and then
+            auto lastUpdate = std::chrono::steady_clock::now();
+            manifest = Globals::gScanner.scanTree(
+                tab.path, Globals::gSettings.maxScanDepth, [&](const DirectoryManifest &found) {
+                    if (std::chrono::steady_clock::now() - lastUpdate > std::chrono::milliseconds(250))
+                    {
+                        lastUpdate = std::chrono::steady_clock::now();
+                        if (publish(found))
+                        {
+                            onTabsChanged();
+                        }
+                    }
+
+                    return !shouldStopScanning;
+                });
+        }
+        else
+        {
+            manifest = Globals::gScanner.scan(tab.path);
+        }
+
+        if (shouldStopScanning)
+        {
+            return;
+        }
+
+        auto newTab = publish(manifest);
+        if (newTab)
+        {
+            onTabsChanged();
+        }
+
+        //* Hashing has to read every new file once, so the sounds are shown before and get their content id after
+        auto hashed = Globals::gScanner.hashContents(manifest, shouldStopScanning) && !shouldStopScanning;
+
+        {
+            //* Journaled while holding the library, so that the entry reflects every change that came before it
+            auto lock = Globals::gData.lock();
+            if (hashed)
+            {
+                newTab = publish(manifest);
+            }
+            else if (newTab)
+            {
+                newTab = Globals::gData.getTab(newTab->id);
+            }
+
+            if (newTab)
+            {
+                Globals::gJournal.onTabChanged(*newTab);
+            }
+        }
+
+        if (newTab)
+        {
+            if (Globals::gSettings.normalizeLoudness)
+            {
+                Globals::gLoudness.analyze(newTab->sounds);
+            }
+
+            //* Files that are gone from the tab don't need their loudness anymore
+            Globals::gLoudness.prune(Globals::gData.getTabs());
+            onTabsChanged();
+        }
+    }
+    std::optional<Tab> Window::applyTabContent(const Tab &tab, const DirectoryManifest &manifest)
+    {
+        //* The tab might have been changed or removed while it was scanned, so we always build on its current state.
+        //* This also runs on the scanner pool, so the library stays locked from reading the tab until it was replaced.
+        auto lock = Globals::gData.lock();
+
+        auto current = Globals::gData.getTab(tab.id);
+        if (!current || current->path != tab.path)
+        {
+            return std::nullopt;
+        }
+
+        current->sounds = buildTabContent(*current, manifest);
+        return Globals::gData.setTab(current->id, *current);
+    }
+    std::optional<DirectoryManifest> Window::getCachedTabContent(const Tab &tab) const
+    {
+        if (Globals::gSettings.recursiveTabs)
+        {
+            return Globals::gScanner.getTree(tab.path, Globals::gSettings.maxScanDepth);
+        }
+
+        return Globals::gScanner.getManifest(tab.path);
+    }
+    std::optional<DirectoryManifest> Window::scanTab(const Tab &tab) const
     {
 #if defined(_WIN32)
         const auto path = Helpers::widen(tab.path);
@@ -37,93 +206,85 @@ namespace Soundux::Objects
 
         if (std::filesystem::exists(path))
         {
-            std::vector<Sound> rtn;
-            for (const auto &entry : std::filesystem::directory_iterator(path))
+            if (Globals::gSettings.recursiveTabs)
             {
-                std::filesystem::path file = entry;
-                if (entry.is_symlink())
-                {
-                    file = std::filesystem::read_symlink(entry);
-                    if (file.has_relative_path())
-                    {
-                        file = std::filesystem::canonical(path / file);
-                    }
-                }
+                return Globals::gScanner.scanTree(tab.path, Globals::gSettings.maxScanDepth);
+            }
 
-                auto extension = file.extension().u8string();
-                std::transform(extension.begin(), extension.end(), extension.begin(),
-                               [](char c) { return std::tolower(c); });
-                if (extension != ".mp3" && extension != ".wav" && extension != ".flac")
-                {
-                    continue;
-                }
+            return Globals::gScanner.scan(tab.path);
+        }
 
-                Sound sound;
+        Globals::gScanner.forget(tab.path);
+        Fancy::fancy.logTime().warning() << "Path " >> tab.path << " does not exist" << std::endl;
+        return std::nullopt;
+    }
+    std::vector<Sound> Window::getTabContent(const Tab &tab) const
+    {
+        if (auto manifest = scanTab(tab); manifest)
+        {
+            return buildTabContent(tab, *manifest);
+        }
 
-                std::error_code ec;
-                auto writeTime = std::filesystem::last_write_time(file, ec);
-                if (!ec)
-                {
-                    sound.modifiedDate = writeTime.time_since_epoch().count();
-                }
-                else
-                {
-                    Fancy::fancy.logTime().warning() << "Failed to read lastWriteTime of " << file << std::endl;
-                }
+        return {};
+    }
+    std::vector<Sound> Window::buildTabContent(const Tab &tab, const DirectoryManifest &manifest) const
+    {
+        TraceScope scope("Window::buildTabContent");
 
-                sound.path = file.u8string();
-#if defined(_WIN32)
-                std::transform(sound.path.begin(), sound.path.end(), sound.path.begin(),
-                               [](char c) { return c == '\\' ? '/' : c; });
-#endif
-                sound.name = file.stem().u8string();
+        //* Sound ids are handed out here, which can happen on the rescan thread as well
+        auto lock = Globals::gData.lock();
 
-                auto oldSound = std::find_if(tab.sounds.begin(), tab.sounds.end(),
-                                             [&sound](const auto &item) { return item.path == sound.path; });
+        std::vector<Sound> rtn;
+        for (const auto &entry : manifest.entries)
+        {
+            Sound sound;
+            sound.path = entry.path;
+            sound.modifiedDate = entry.modifiedDate;
+            sound.contentId = entry.contentHash;
+            sound.name = std::filesystem::u8path(entry.path).stem().u8string();
 
-                if (oldSound != tab.sounds.end())
-                {
-                    sound.id = oldSound->id;
-                    sound.hotkeys = oldSound->hotkeys;
-                    sound.isFavorite = oldSound->isFavorite;
-                    sound.localVolume = oldSound->localVolume;
-                    sound.remoteVolume = oldSound->remoteVolume;
-                }
-                else
-                {
-                    sound.id = ++Globals::gData.soundIdCounter;
-                }
+            auto oldSound = std::find_if(tab.sounds.begin(), tab.sounds.end(),
+                                         [&sound](const auto &item) { return item.path == sound.path; });
 
-                rtn.emplace_back(sound);
+            if (oldSound != tab.sounds.end())
+            {
+                sound.id = oldSound->id;
+                sound.hotkeys = oldSound->hotkeys;
+                sound.isFavorite = oldSound->isFavorite;
+                sound.localVolume = oldSound->localVolume;
+                sound.remoteVolume = oldSound->remoteVolume;
             }
-
-            switch (tab.sortMode)
+            else
             {
-            case Enums::SortMode::ModifiedDate_Descending:
-                std::sort(rtn.begin(), rtn.end(), [](const auto &first, const auto &second) {
-                    return first.modifiedDate > second.modifiedDate;
-                });
-                break;
-            case Enums::SortMode::ModifiedDate_Ascending:
-                std::sort(rtn.begin(), rtn.end(), [](const auto &first, const auto &second) {
-                    return first.modifiedDate < second.modifiedDate;
-                });
-                break;
-            case Enums::SortMode::Alphabetical_Descending:
-                std::sort(rtn.begin(), rtn.end(),
-                          [](const auto &first, const auto &second) { return first.name > second.name; });
-                break;
-            case Enums::SortMode::Alphabetical_Ascending:
-                std::sort(rtn.begin(), rtn.end(),
-                          [](const auto &first, const auto &second) { return first.name < second.name; });
-                break;
+                sound.id = ++Globals::gData.soundIdCounter;
             }
 
-            return rtn;
+            rtn.emplace_back(sound);
         }
 
-        Fancy::fancy.logTime().warning() << "Path " >> tab.path << " does not exist" << std::endl;
-        return {};
+        switch (tab.sortMode)
+        {
+        case Enums::SortMode::ModifiedDate_Descending:
+            std::sort(rtn.begin(), rtn.end(), [](const auto &first, const auto &second) {
+                return first.modifiedDate > second.modifiedDate;
+            });
+            break;
+        case Enums::SortMode::ModifiedDate_Ascending:
+            std::sort(rtn.begin(), rtn.end(), [](const auto &first, const auto &second) {
+                return first.modifiedDate < second.modifiedDate;
+            });
+            break;
+        case Enums::SortMode::Alphabetical_Descending:
+            std::sort(rtn.begin(), rtn.end(),
+                      [](const auto &first, const auto &second) { return first.name > second.name; });
+            break;
+        case Enums::SortMode::Alphabetical_Ascending:
+            std::sort(rtn.begin(), rtn.end(),
+                      [](const auto &first, const auto &second) { return first.name < second.name; });
+            break;
+        }
+
+        return rtn;
     }
     std::vector<Tab> Window::addTab()
     {
@@ -160,6 +321,28 @@ namespace Soundux::Objects
                                [](wchar_t c) { return c == '/' ? '\\' : c; });
 #endif
 
+                if (Globals::gSettings.recursiveTabs)
+                {
+                    //* The subdirectories are part of the tab, which shows the top level right away and receives the
+                    //* rest while the tree is walked
+                    if (!Globals::gData.doesTabExist(rootPath))
+                    {
+                        Tab rootTab;
+                        rootTab.path = rootPath;
+                        rootTab.sounds = buildTabContent(rootTab, Globals::gScanner.scan(rootPath));
+                        rootTab.name = std::filesystem::path(rootPath).filename().u8string();
+
+                        {
+                            auto lock = Globals::gData.lock();
+                            tabs.emplace_back(Globals::gData.addTab(std::move(rootTab)));
+                            Globals::gJournal.onTabAdded(tabs.back());
+                        }
+                        queueScan(tabs.back());
+                    }
+
+                    return tabs;
+                }
+
                 if (!Globals::gData.doesTabExist(rootPath))
                 {
                     Tab rootTab;
@@ -167,7 +350,12 @@ namespace Soundux::Objects
                     rootTab.sounds = getTabContent(rootTab);
                     rootTab.name = std::filesystem::path(rootPath).filename().u8string();
 
-                    tabs.emplace_back(Globals::gData.addTab(std::move(rootTab)));
+                    {
+                        auto lock = Globals::gData.lock();
+                        tabs.emplace_back(Globals::gData.addTab(std::move(rootTab)));
+                        Globals::gJournal.onTabAdded(tabs.back());
+                    }
+                    queueScan(tabs.back());
                 }
 
                 for (const auto &entry : std::filesystem::directory_iterator(path))
@@ -189,12 +377,18 @@ namespace Soundux::Objects
 
                             if (!subFolderTab.sounds.empty())
                             {
-                                tabs.emplace_back(Globals::gData.addTab(std::move(subFolderTab)));
+                                {
+                                    auto lock = Globals::gData.lock();
+                                    tabs.emplace_back(Globals::gData.addTab(std::move(subFolderTab)));
+                                    Globals::gJournal.onTabAdded(tabs.back());
+                                }
+                                queueScan(tabs.back());
                             }
                         }
                     }
                 }
 
+                //* The scanner hashes the contents and analyzes the loudness of the new tabs in the background
                 return tabs;
             }
             Fancy::fancy.logTime().warning() << "Selected Folder does not exist!" << std::endl;
@@ -206,6 +400,8 @@ namespace Soundux::Objects
 #if defined(__linux__)
     std::optional<PlayingSound> Window::playSound(const std::uint32_t &id)
     {
+        awaitAudio();
+
         auto sound = Globals::gData.getSound(id);
         if (sound)
         {
@@ -217,7 +413,7 @@ namespace Soundux::Objects
             {
                 if (Globals::gAudioBackend)
                 {
-                    if (!Globals::gAudioBackend->muteInput(true))
+                    if (!Globals::gAudioBackend->startMuteSession())
                     {
                         onError(Enums::ErrorCode::FailedToMute);
                     }
@@ -234,6 +430,7 @@ namespace Soundux::Objects
             if (playingSound && remotePlayingSound)
             {
                 groupedSounds->insert({playingSound->id, remotePlayingSound->id});
+                Globals::gAudio.link(playingSound->id, remotePlayingSound->id);
                 if (Globals::gSettings.outputs.empty() && playingSound)
                 {
                     return *playingSound;
@@ -271,6 +468,12 @@ namespace Soundux::Objects
             return std::nullopt;
         }
 
+        //* Ends the mute session we might have started above
+        if (Globals::gAudio.getPlayingSounds().empty())
+        {
+            onAllSoundsFinished();
+        }
+
         Fancy::fancy.logTime().failure() << "Failed to play sound " << id << std::endl;
         onError(Enums::ErrorCode::FailedToPlay);
         return std::nullopt;
@@ -278,6 +481,8 @@ namespace Soundux::Objects
 #else
     std::optional<PlayingSound> Window::playSound(const std::uint32_t &id)
     {
+        awaitAudio();
+
         auto sound = Globals::gData.getSound(id);
         if (sound)
         {
@@ -314,6 +519,7 @@ namespace Soundux::Objects
                 if (playingSound && remotePlayingSound)
                 {
                     groupedSounds->insert({playingSound->id, remotePlayingSound->id});
+                    Globals::gAudio.link(playingSound->id, remotePlayingSound->id);
                     return *playingSound;
                 }
 
@@ -338,6 +544,8 @@ namespace Soundux::Objects
 #endif
     std::optional<PlayingSound> Window::pauseSound(const std::uint32_t &id)
     {
+        awaitAudio();
+
         std::optional<std::uint32_t> remoteSoundId;
         if (!Globals::gSettings.outputs.empty() && !Globals::gSettings.useAsDefaultDevice)
         {
@@ -371,6 +579,8 @@ namespace Soundux::Objects
     }
     std::optional<PlayingSound> Window::resumeSound(const std::uint32_t &id)
     {
+        awaitAudio();
+
         std::optional<std::uint32_t> remoteSoundId;
         if (!Globals::gSettings.outputs.empty() && !Globals::gSettings.useAsDefaultDevice)
         {
@@ -404,6 +614,8 @@ namespace Soundux::Objects
     }
     std::optional<PlayingSound> Window::seekSound(const std::uint32_t &id, std::uint64_t seekTo)
     {
+        awaitAudio();
+
         std::optional<std::uint32_t> remoteSoundId;
         if (!Globals::gSettings.outputs.empty() && !Globals::gSettings.useAsDefaultDevice)
         {
@@ -437,6 +649,8 @@ namespace Soundux::Objects
     }
     std::optional<PlayingSound> Window::repeatSound(const std::uint32_t &id, bool shouldRepeat)
     {
+        awaitAudio();
+
         std::optional<std::uint32_t> remoteSoundId;
         if (!Globals::gSettings.outputs.empty() && !Globals::gSettings.useAsDefaultDevice)
         {
@@ -471,11 +685,26 @@ namespace Soundux::Objects
     }
     std::vector<Tab> Window::removeTab(const std::uint32_t &id)
     {
-        Globals::gData.removeTabById(id);
-        return Globals::gData.getTabs();
+        {
+            auto lock = Globals::gData.lock();
+            if (auto tab = Globals::gData.getTab(id); tab)
+            {
+                Globals::gScanner.forget(tab->path);
+            }
+
+            Globals::gData.removeTabById(id);
+            Globals::gJournal.onTabRemoved(id);
+        }
+
+        auto tabs = Globals::gData.getTabs();
+        Globals::gLoudness.prune(tabs);
+
+        return tabs;
     }
     bool Window::stopSound(const std::uint32_t &id)
     {
+        awaitAudio();
+
         std::optional<std::uint32_t> remoteSoundId;
         if (!Globals::gSettings.outputs.empty() && !Globals::gSettings.useAsDefaultDevice)
         {
@@ -505,6 +734,8 @@ namespace Soundux::Objects
     }
     void Window::stopSounds(bool sync)
     {
+        awaitAudio();
+
         if (!sync)
         {
             Globals::gQueue.push_unique(0, []() { Globals::gAudio.stopAll(); });
@@ -533,17 +764,20 @@ namespace Soundux::Objects
     }
     std::optional<Sound> Window::setCustomLocalVolume(const std::uint32_t &id, const std::optional<int> &localVolume)
     {
-        auto sound = Globals::gData.getSound(id);
+        auto lock = Globals::gData.lock();
+        auto sound = Globals::gData.modifySound(id, [&](Sound &sound) { sound.localVolume = localVolume; });
         if (sound)
         {
-            sound->get().localVolume = localVolume;
+            Globals::gJournal.onSoundChanged(*sound);
+            lock.unlock();
 
             for (auto &playingSound : Globals::gAudio.getPlayingSounds())
             {
-                if (playingSound.sound.id == sound->get().id && playingSound.playbackDevice.isDefault)
+                if (playingSound.sound.id == sound->id && playingSound.playbackDevice.isDefault)
                 {
-                    playingSound.raw.device.load()->masterVolumeFactor =
-                        static_cast<float>(localVolume ? *localVolume : Globals::gSettings.localVolume) / 100.f;
+                    Globals::gAudio.setVolume(
+                        playingSound.id,
+                        static_cast<float>(localVolume ? *localVolume : Globals::gSettings.localVolume) / 100.f);
                 }
             }
 
@@ -557,17 +791,20 @@ namespace Soundux::Objects
     }
     std::optional<Sound> Window::setCustomRemoteVolume(const std::uint32_t &id, const std::optional<int> &remoteVolume)
     {
-        auto sound = Globals::gData.getSound(id);
+        auto lock = Globals::gData.lock();
+        auto sound = Globals::gData.modifySound(id, [&](Sound &sound) { sound.remoteVolume = remoteVolume; });
         if (sound)
         {
-            sound->get().remoteVolume = remoteVolume;
+            Globals::gJournal.onSoundChanged(*sound);
+            lock.unlock();
 
             for (auto &playingSound : Globals::gAudio.getPlayingSounds())
             {
-                if (playingSound.sound.id == sound->get().id && !playingSound.playbackDevice.isDefault)
+                if (playingSound.sound.id == sound->id && !playingSound.playbackDevice.isDefault)
                 {
-                    playingSound.raw.device.load()->masterVolumeFactor =
-                        static_cast<float>(remoteVolume ? *remoteVolume : Globals::gSettings.remoteVolume) / 100.f;
+                    Globals::gAudio.setVolume(
+                        playingSound.id,
+                        static_cast<float>(remoteVolume ? *remoteVolume : Globals::gSettings.remoteVolume) / 100.f);
                 }
             }
 
@@ -579,8 +816,75 @@ namespace Soundux::Objects
         onError(Enums::ErrorCode::FailedToSetCustomVolume);
         return std::nullopt;
     }
+    std::vector<Sound> Window::setCustomVolumes(const std::vector<VolumeUpdate> &updates, bool remote)
+    {
+        std::vector<Sound> rtn;
+        std::unordered_map<std::uint32_t, std::optional<int>> volumes;
+        bool failed = false;
+
+        {
+            auto lock = Globals::gData.lock();
+            for (const auto &update : updates)
+            {
+                auto sound = Globals::gData.modifySound(update.id, [&](Sound &sound) {
+                    (remote ? sound.remoteVolume : sound.localVolume) = update.volume;
+                });
+                if (!sound)
+                {
+                    Fancy::fancy.logTime().failure() << "Failed to set custom " << (remote ? "remote" : "local")
+                                                     << " volume for sound " << update.id << ", sound does not exist"
+                                                     << std::endl;
+                    failed = true;
+                    continue;
+                }
+
+                volumes.insert_or_assign(update.id, update.volume);
+                rtn.emplace_back(*sound);
+            }
+
+            if (!rtn.empty())
+            {
+                Globals::gJournal.onSoundsChanged(rtn);
+            }
+        }
+
+        if (!rtn.empty())
+        {
+            const auto defaultVolume = remote ? Globals::gSettings.remoteVolume : Globals::gSettings.localVolume;
+            for (const auto &playingSound : Globals::gAudio.getPlayingSounds())
+            {
+                if (playingSound.playbackDevice.isDefault == remote)
+                {
+                    continue;
+                }
+
+                if (auto volume = volumes.find(playingSound.sound.id); volume != volumes.end())
+                {
+                    Globals::gAudio.setVolume(
+                        playingSound.id, static_cast<float>(volume->second ? *volume->second : defaultVolume) / 100.f);
+                }
+            }
+        }
+
+        if (failed)
+        {
+            onError(Enums::ErrorCode::FailedToSetCustomVolume);
+        }
+
+        return rtn;
+    }
+    std::vector<Sound> Window::setCustomLocalVolumes(const std::vector<VolumeUpdate> &updates)
+    {
+        return setCustomVolumes(updates, false);
+    }
+    std::vector<Sound> Window::setCustomRemoteVolumes(const std::vector<VolumeUpdate> &updates)
+    {
+        return setCustomVolumes(updates, true);
+    }
     Settings Window::changeSettings(Settings settings)
     {
+        awaitAudio();
+
         auto oldSettings = Globals::gSettings;
         Globals::gSettings = settings;
 
@@ -601,12 +905,28 @@ namespace Soundux::Objects
                     newVolume = sound.remoteVolume ? *sound.remoteVolume : Globals::gSettings.remoteVolume;
                 }
 
-                playingSound.raw.device.load()->masterVolumeFactor = static_cast<float>(newVolume) / 100.f;
+                Globals::gAudio.setVolume(playingSound.id, static_cast<float>(newVolume) / 100.f);
+            }
+        }
+
+        if (settings.latencyMode != oldSettings.latencyMode)
+        {
+            Globals::gAudio.tuneLatency();
+        }
+
+        if (settings.normalizeLoudness && !oldSettings.normalizeLoudness)
+        {
+            for (const auto &tab : Globals::gData.getTabs())
+            {
+                Globals::gLoudness.analyze(tab.sounds);
             }
         }
 
 #if defined(__linux__)
-        if (settings.audioBackend != oldSettings.audioBackend)
+        auto nativeOutputChanged = settings.audioBackend == Enums::BackendType::PipeWire &&
+                                   settings.nativeOutput != oldSettings.nativeOutput;
+
+        if (settings.audioBackend != oldSettings.audioBackend || nativeOutputChanged)
         {
             stopSounds(true);
 
@@ -615,8 +935,23 @@ namespace Soundux::Objects
                 Globals::gAudioBackend->destroy();
             }
 
-            Globals::gAudioBackend = AudioBackend::createInstance(settings.audioBackend);
+            Globals::gAudioBackend = AudioBackend::createInstance(Globals::gSettings.audioBackend);
             Globals::gAudio.setup();
+
+            if (auto pulseBackend = std::dynamic_pointer_cast<PulseAudio>(Globals::gAudioBackend); pulseBackend)
+            {
+                pulseBackend->switchOnConnectPresent();
+            }
+        }
+        else if (settings.inProcessPassthrough != oldSettings.inProcessPassthrough)
+        {
+            if (auto pulseBackend = std::dynamic_pointer_cast<PulseAudio>(Globals::gAudioBackend); pulseBackend)
+            {
+                if (!pulseBackend->updatePassthroughModules())
+                {
+                    onError(Enums::ErrorCode::FailedToStartPassthrough);
+                }
+            }
         }
         if (Globals::gAudioBackend)
         {
@@ -624,14 +959,14 @@ namespace Soundux::Objects
             {
                 if (settings.muteDuringPlayback && !oldSettings.muteDuringPlayback)
                 {
-                    if (!Globals::gAudioBackend->muteInput(true))
+                    if (!Globals::gAudioBackend->startMuteSession())
                     {
                         onError(Enums::ErrorCode::FailedToMute);
                     }
                 }
                 else if (!settings.muteDuringPlayback && oldSettings.muteDuringPlayback)
                 {
-                    if (!Globals::gAudioBackend->muteInput(false))
+                    if (!Globals::gAudioBackend->endMuteSession())
                     {
                         onError(Enums::ErrorCode::FailedToMute);
                     }
@@ -712,8 +1047,23 @@ namespace Soundux::Objects
             }
         }
 #endif
+        Globals::gSaver.markSettingsDirty(Globals::gSettings);
         return Globals::gSettings;
     }
+    void Window::setAudioSetup(std::shared_future<Enums::BackendType> setup)
+    {
+        audioSetup = std::move(setup);
+    }
+    void Window::awaitAudio()
+    {
+        if (!audioSetup.valid())
+        {
+            return;
+        }
+
+        //* The backend might have been changed if the configured one was not available
+        std::call_once(audioReady, [this] { Globals::gSettings.audioBackend = audioSetup.get(); });
+    }
     void Window::onHotKeyReceived([[maybe_unused]] const std::vector<int> &keys)
     {
         Globals::gHotKeys.shouldNotify(false);
@@ -723,10 +1073,19 @@ namespace Soundux::Objects
         auto tab = Globals::gData.getTab(id);
         if (tab)
         {
-            tab->sounds = getTabContent(*tab);
-            auto newTab = Globals::gData.setTab(id, *tab);
+            //* The directory is walked without holding the library
+            auto manifest = scanTab(*tab).value_or(DirectoryManifest{});
+
+            auto lock = Globals::gData.lock();
+            auto newTab = applyTabContent(*tab, manifest);
             if (newTab)
             {
+                Globals::gJournal.onTabChanged(*newTab);
+                lock.unlock();
+
+                //* New files still have to be hashed, their loudness is analyzed afterwards
+                queueScan(*newTab);
+
                 return newTab;
             }
         }
@@ -739,9 +1098,28 @@ namespace Soundux::Objects
         auto tab = Globals::gData.getTab(id);
         if (tab)
         {
-            tab->sortMode = sortMode;
-            tab->sounds = getTabContent(*tab);
-            auto newTab = Globals::gData.setTab(id, *tab);
+            auto manifest = getCachedTabContent(*tab);
+            if (!manifest)
+            {
+                manifest = scanTab(*tab);
+            }
+
+            std::optional<Tab> newTab;
+            {
+                auto lock = Globals::gData.lock();
+                if (auto current = Globals::gData.getTab(id); current && current->path == tab->path)
+                {
+                    current->sortMode = sortMode;
+                    current->sounds = buildTabContent(*current, manifest.value_or(DirectoryManifest{}));
+                    newTab = Globals::gData.setTab(id, *current);
+                }
+
+                if (newTab)
+                {
+                    Globals::gJournal.onTabChanged(*newTab);
+                }
+            }
+
             if (newTab)
             {
                 return newTab;
@@ -755,32 +1133,79 @@ namespace Soundux::Objects
     }
     std::optional<Sound> Window::setHotkey(const std::uint32_t &id, const std::vector<int> &hotkeys)
     {
-        auto sound = Globals::gData.getSound(id);
+        auto lock = Globals::gData.lock();
+        auto sound = Globals::gData.modifySound(id, [&](Sound &sound) { sound.hotkeys = hotkeys; });
         if (sound)
         {
-            sound->get().hotkeys = hotkeys;
-            return sound->get();
+            Globals::gJournal.onSoundChanged(*sound);
+            return sound;
         }
+        lock.unlock();
+
         Fancy::fancy.logTime().failure() << "Failed to set hotkey for sound " << id << ", sound does not exist"
                                          << std::endl;
         onError(Enums::ErrorCode::FailedToSetHotkey);
         return std::nullopt;
     }
+    std::vector<Sound> Window::setHotkeys(const std::vector<HotkeyUpdate> &updates)
+    {
+        std::vector<Sound> rtn;
+        bool failed = false;
+
+        {
+            auto lock = Globals::gData.lock();
+            for (const auto &update : updates)
+            {
+                auto sound =
+                    Globals::gData.modifySound(update.id, [&](Sound &sound) { sound.hotkeys = update.hotkeys; });
+                if (!sound)
+                {
+                    Fancy::fancy.logTime().failure() << "Failed to set hotkey for sound " << update.id
+                                                     << ", sound does not exist" << std::endl;
+                    failed = true;
+                    continue;
+                }
+
+                rtn.emplace_back(*sound);
+            }
+
+            if (!rtn.empty())
+            {
+                Globals::gJournal.onSoundsChanged(rtn);
+            }
+        }
+
+        if (failed)
+        {
+            onError(Enums::ErrorCode::FailedToSetHotkey);
+        }
+
+        return rtn;
+    }
     std::vector<Tab> Window::changeTabOrder(const std::vector<int> &newOrder)
     {
         std::vector<Tab> newTabs;
         newTabs.reserve(newOrder.size());
 
+        auto lock = Globals::gData.lock();
         for (auto tabId : newOrder)
         {
             newTabs.emplace_back(*Globals::gData.getTab(tabId));
         }
         Globals::gData.setTabs(newTabs);
+        Globals::gJournal.onTabsReordered(newOrder);
         return Globals::gData.getTabs();
     }
 #if defined(__linux__)
+    std::shared_ptr<IconFetcher> Window::getIconFetcher()
+    {
+        std::call_once(iconsCreated, [] { Globals::gIcons = IconFetcher::createInstance(); });
+        return Globals::gIcons;
+    }
     std::vector<std::shared_ptr<IconRecordingApp>> Window::getOutputs()
     {
+        awaitAudio();
+
         //* The frontend only uses the stream name and should only show multiple streams that belong to one application
         //* once. The backend (gPulse.getRecordingStreams()) will work with multiple instances, so we need to filter out
         //* duplicates here.
@@ -802,11 +1227,11 @@ namespace Soundux::Objects
                 if (stream && item == std::end(uniqueStreams))
                 {
                     auto iconStream = std::make_shared<IconRecordingApp>(*stream);
-                    if (Globals::gIcons)
+                    if (auto icons = getIconFetcher(); icons)
                     {
                         if (auto pulseApp = std::dynamic_pointer_cast<PulseRecordingApp>(stream); pulseApp)
                         {
-                            auto icon = Soundux::Globals::gIcons->getIcon(static_cast<int>(pulseApp->pid));
+                            auto icon = icons->getIcon(static_cast<int>(pulseApp->pid));
                             if (icon)
                             {
                                 iconStream->appIcon = *icon;
@@ -815,7 +1240,7 @@ namespace Soundux::Objects
                         else if (auto pipeWireApp = std::dynamic_pointer_cast<PipeWireRecordingApp>(stream);
                                  pipeWireApp)
                         {
-                            auto icon = Soundux::Globals::gIcons->getIcon(static_cast<int>(pipeWireApp->pid));
+                            auto icon = icons->getIcon(static_cast<int>(pipeWireApp->pid));
                             if (icon)
                             {
                                 iconStream->appIcon = *icon;
@@ -832,6 +1257,8 @@ namespace Soundux::Objects
     }
     std::vector<std::shared_ptr<IconPlaybackApp>> Window::getPlayback()
     {
+        awaitAudio();
+
         std::vector<std::shared_ptr<IconPlaybackApp>> uniqueStreams;
 
         if (Globals::gAudioBackend)
@@ -851,11 +1278,11 @@ namespace Soundux::Objects
                 {
                     auto iconStream = std::make_shared<IconPlaybackApp>(*stream);
 
-                    if (Globals::gIcons)
+                    if (auto icons = getIconFetcher(); icons)
                     {
                         if (auto pulseApp = std::dynamic_pointer_cast<PulsePlaybackApp>(stream); pulseApp)
                         {
-                            auto icon = Soundux::Globals::gIcons->getIcon(static_cast<int>(pulseApp->pid));
+                            auto icon = icons->getIcon(static_cast<int>(pulseApp->pid));
                             if (icon)
                             {
                                 iconStream->appIcon = *icon;
@@ -863,7 +1290,7 @@ namespace Soundux::Objects
                         }
                         if (auto pipeWireApp = std::dynamic_pointer_cast<PipeWirePlaybackApp>(stream); pipeWireApp)
                         {
-                            auto icon = Soundux::Globals::gIcons->getIcon(static_cast<int>(pipeWireApp->pid));
+                            auto icon = icons->getIcon(static_cast<int>(pipeWireApp->pid));
                             if (icon)
                             {
                                 iconStream->appIcon = *icon;
@@ -880,6 +1307,8 @@ namespace Soundux::Objects
     }
     bool Window::startPassthrough(const std::string &name)
     {
+        awaitAudio();
+
         bool success = true;
         if (Globals::gAudioBackend && !Globals::gSettings.outputs.empty())
         {
@@ -910,6 +1339,8 @@ namespace Soundux::Objects
     }
     void Window::stopPassthrough(const std::string &name)
     {
+        awaitAudio();
+
         if (Globals::gAudioBackend)
         {
             if (Globals::gAudio.getPlayingSounds().empty() &&
@@ -930,6 +1361,8 @@ namespace Soundux::Objects
 #else
     std::vector<AudioDevice> Window::getOutputs()
     {
+        awaitAudio();
+
         return Globals::gAudio.getAudioDevices();
     }
 #endif
@@ -957,12 +1390,10 @@ namespace Soundux::Objects
 #if defined(__linux__)
         if (Globals::gAudioBackend)
         {
-            if (Globals::gSettings.muteDuringPlayback)
+            //* Does not reach the server if no mute session was started
+            if (!Globals::gAudioBackend->endMuteSession())
             {
-                if (!Globals::gAudioBackend->muteInput(false))
-                {
-                    onError(Enums::ErrorCode::FailedToMute);
-                }
+                onError(Enums::ErrorCode::FailedToMute);
             }
             if (Globals::gAudioBackend->currentlyPassedThrough().empty())
             {
@@ -992,6 +1423,31 @@ namespace Soundux::Objects
             Globals::gHotKeys.pressKeys(Globals::gSettings.pushToTalkKeys);
         }
     }
+    std::vector<std::vector<std::uint32_t>> Window::getDuplicates()
+    {
+        std::map<std::uint64_t, std::vector<std::uint32_t>> byContent;
+        for (const auto &tab : Globals::gData.getTabs())
+        {
+            for (const auto &sound : tab.sounds)
+            {
+                if (sound.contentId)
+                {
+                    byContent[sound.contentId].emplace_back(sound.id);
+                }
+            }
+        }
+
+        std::vector<std::vector<std::uint32_t>> rtn;
+        for (auto &[contentId, ids] : byContent)
+        {
+            if (ids.size() > 1)
+            {
+                rtn.emplace_back(std::move(ids));
+            }
+        }
+
+        return rtn;
+    }
     void Window::setIsOnFavorites(bool state)
     {
         Globals::gData.isOnFavorites = state;
@@ -1001,11 +1457,13 @@ namespace Soundux::Objects
         auto sound = Globals::gData.getSound(id);
         if (sound)
         {
-            if (!Helpers::deleteFile(sound->get().path, Globals::gSettings.deleteToTrash))
+            if (!Helpers::deleteFile(sound->path, Globals::gSettings.deleteToTrash))
             {
                 onError(Enums::ErrorCode::FailedToDelete);
                 return false;
             }
+
+            Globals::gLoudness.forget(sound->path);
             return true;
         }
 
@@ -1015,6 +1473,8 @@ namespace Soundux::Objects
     }
     bool Window::toggleSoundPlayback()
     {
+        awaitAudio();
+
         bool shouldPause = true;
         for (const auto &sound : Globals::gAudio.getPlayingSounds())
         {
@@ -5,9 +5,14 @@
 #include <helper/audio/linux/backend.hpp>
 #endif
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
 #include <var_guard.hpp>
 
 namespace Soundux
@@ -15,6 +20,8 @@ namespace Soundux
     namespace Objects
     {
 #if defined(__linux__)
+        class IconFetcher;
+
         struct IconRecordingApp : public RecordingApp
         {
             std::string appIcon;
@@ -50,9 +57,33 @@ namespace Soundux
             virtual void onAllSoundsFinished();
 
           protected:
+            std::thread scanner;
+            std::mutex scanMutex;
+            std::condition_variable scanCv;
+            std::deque<Tab> pendingScans;
+            std::atomic<bool> shouldStopScanning = false;
+
+            //* Scans queued tabs in the background and hands their sounds to the ui as they are found. Tabs whose
+            //* directories changed since the last start are queued on setup, so this is started once the ui exists.
+            void startScanner();
+            void stopScanner();
+            void queueScan(const Tab &);
+            void scanInBackground(const Tab &);
+
             virtual std::vector<Sound> getTabContent(const Tab &) const;
+            std::vector<Sound> buildTabContent(const Tab &, const DirectoryManifest &) const;
+            std::optional<DirectoryManifest> getCachedTabContent(const Tab &) const;
+            std::optional<DirectoryManifest> scanTab(const Tab &) const;
+            //* Rebuilds the sounds of the tab from the manifest, unless the tab was removed or replaced since
+            std::optional<Tab> applyTabContent(const Tab &, const DirectoryManifest &);
+
+            std::vector<Sound> setCustomVolumes(const std::vector<VolumeUpdate> &, bool);
 
 #if defined(__linux__)
+            std::once_flag iconsCreated;
+            //* Creating the icon fetcher loads gdk, so it is only done once the outputs are first requested
+            std::shared_ptr<IconFetcher> getIconFetcher();
+
             virtual std::vector<std::shared_ptr<IconRecordingApp>> getOutputs();
             virtual std::vector<std::shared_ptr<IconPlaybackApp>> getPlayback();
 #else
@@ -63,6 +94,8 @@ namespace Soundux
             virtual void setIsOnFavorites(bool);
             virtual Settings changeSettings(Settings);
             virtual bool deleteSound(const std::uint32_t &);
+            //* Groups of sounds that share the same file contents, only knows about sounds that were hashed already
+            virtual std::vector<std::vector<std::uint32_t>> getDuplicates();
 
 #if defined(__linux__)
             void stopPassthrough(const std::string &);
@@ -92,14 +125,29 @@ namespace Soundux
             virtual std::optional<Sound> setCustomLocalVolume(const std::uint32_t &, const std::optional<int> &);
             virtual std::optional<Sound> setCustomRemoteVolume(const std::uint32_t &, const std::optional<int> &);
 
+            //* Apply all updates under a single lock and record them as one change, returns the updated sounds
+            virtual std::vector<Sound> setHotkeys(const std::vector<HotkeyUpdate> &);
+            virtual std::vector<Sound> setCustomLocalVolumes(const std::vector<VolumeUpdate> &);
+            virtual std::vector<Sound> setCustomRemoteVolumes(const std::vector<VolumeUpdate> &);
+
+          protected:
+            std::shared_future<Enums::BackendType> audioSetup;
+            std::once_flag audioReady;
+
           public:
             virtual ~Window();
             virtual void setup();
+
+            //* The window is shown while the audio is still being set up, everything that plays sounds or talks to
+            //* the backend waits for it first
+            void setAudioSetup(std::shared_future<Enums::BackendType>);
+            void awaitAudio();
             virtual void show() = 0;
             virtual void mainLoop() = 0;
 
             virtual void onAdminRequired() = 0;
             virtual void onSettingsChanged() = 0;
+            virtual void onTabsChanged() = 0;
             virtual void onSwitchOnConnectDetected(bool) = 0;
             virtual void onSoundPlayed(const PlayingSound &);
             virtual void onError(const Enums::ErrorCode &) = 0;